@@ -0,0 +1,32 @@
+//
+//  OCArguments.cpp
+//  occommon
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <errno.h>
+#include "OCUtilities.h"
+
+/************************************************************************/
+/*																		*/
+/*	Arguments															*/
+/*																		*/
+/************************************************************************/
+
+/*	OCParseNumber
+ *
+ *		Parse a decimal number between min and max. Returns false if the
+ *	argument is not entirely a number, or is out of range
+ */
+
+bool OCParseNumber(const char *str, long min, long max, long &value)
+{
+	char *end;
+
+	errno = 0;
+	value = strtol(str,&end,10);
+	if ((end == str) || (*end != 0) || (errno != 0)) return false;
+	return (value >= min) && (value <= max);
+}
@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include "OCUtilities.h"
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 /************************************************************************/
 /*																		*/
@@ -70,3 +72,183 @@ OCCompressStates::~OCCompressStates()
 	free(a);
 	free(ja);
 }
+
+/************************************************************************/
+/*																		*/
+/*	Row Displacement													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCCombStates
+ *
+ *		Compress by row displacement. Identical rows are merged, then the
+ *	distinct rows are placed from the fullest to the emptiest, each at the
+ *	lowest base where its entries land on free slots and no other row has
+ *	the same base.
+ */
+
+OCCombStates::OCCombStates(size_t width, size_t height, uint32_t *states, uint32_t illegal)
+{
+	size_t x,y;
+
+	bsize = height;
+	base = (uint32_t *)malloc(sizeof(uint32_t) * (height ? height : 1));
+
+	/*
+	 *	Find the distinct rows, using an open hash table of row indexes
+	 */
+
+	std::vector<uint32_t> rowOf(height);
+	std::vector<uint32_t> rows;
+
+	size_t hsize = 16;
+	while (hsize < height * 2) hsize <<= 1;
+	std::vector<int32_t> hash(hsize,-1);
+
+	for (y = 0; y < height; ++y) {
+		const uint32_t *row = states + y * width;
+
+		uint32_t h = 2166136261U;
+		for (x = 0; x < width; ++x) {
+			h = (h ^ row[x]) * 16777619U;
+		}
+
+		size_t slot = h & (hsize - 1);
+		while (hash[slot] >= 0) {
+			uint32_t r = rows[hash[slot]];
+			if (!memcmp(states + r * width, row, width * sizeof(uint32_t))) break;
+			slot = (slot + 1) & (hsize - 1);
+		}
+
+		if (hash[slot] < 0) {
+			hash[slot] = (int32_t)rows.size();
+			rows.push_back((uint32_t)y);
+		}
+		rowOf[y] = (uint32_t)hash[slot];
+	}
+
+	/*
+	 *	Order the distinct rows with the most entries first. Packing the
+	 *	full rows first leaves the sparse rows to fill the gaps.
+	 */
+
+	size_t i,len = rows.size();
+	std::vector<uint32_t> count(len,0);
+	std::vector<uint32_t> order(len);
+	for (i = 0; i < len; ++i) {
+		const uint32_t *row = states + rows[i] * width;
+		for (x = 0; x < width; ++x) {
+			if (row[x] != illegal) ++count[i];
+		}
+		order[i] = (uint32_t)i;
+	}
+	std::stable_sort(order.begin(),order.end(),[&count](uint32_t a, uint32_t b) {
+		return count[a] > count[b];
+	});
+
+	/*
+	 *	Place each row. The row's first entry must land on a free slot, so
+	 *	we find candidates with freeSlot, which maps each slot to the next
+	 *	free slot at or after it; slots are joined to the one after them as
+	 *	they are used, and paths are halved as we search. Both arrays grow
+	 *	as needed, so they always reach a full row past the base we try.
+	 */
+
+	std::vector<uint32_t> freeSlot;
+	std::vector<bool> baseUsed;
+	std::vector<uint32_t> rowBase(len);
+	std::vector<uint32_t> cols;
+	size_t emptyBase = 0;
+	size_t maxBase = 0;
+
+	for (i = 0; i < len; ++i) {
+		uint32_t r = order[i];
+		const uint32_t *row = states + rows[r] * width;
+
+		cols.clear();
+		for (x = 0; x < width; ++x) {
+			if (row[x] != illegal) cols.push_back((uint32_t)x);
+		}
+
+		size_t b;
+		if (cols.empty()) {
+			while ((emptyBase < baseUsed.size()) && baseUsed[emptyBase]) ++emptyBase;
+			b = emptyBase;
+		} else {
+			for (b = 0;; ++b) {
+				while (freeSlot.size() <= b + width) {
+					freeSlot.push_back((uint32_t)freeSlot.size());
+				}
+
+				// Next free slot for the first entry
+				size_t s = b + cols[0];
+				while (freeSlot[s] != s) {
+					freeSlot[s] = freeSlot[freeSlot[s]];
+					s = freeSlot[s];
+				}
+				b = s - cols[0];
+				while (freeSlot.size() <= b + width) {
+					freeSlot.push_back((uint32_t)freeSlot.size());
+				}
+
+				if ((b < baseUsed.size()) && baseUsed[b]) continue;
+
+				size_t c,clen = cols.size();
+				for (c = 1; c < clen; ++c) {
+					if (freeSlot[b + cols[c]] != b + cols[c]) break;
+				}
+				if (c == clen) break;
+			}
+
+			std::vector<uint32_t>::iterator c;
+			for (c = cols.begin(); c != cols.end(); ++c) {
+				freeSlot[b + *c] = (uint32_t)(b + *c + 1);
+			}
+		}
+
+		if (b >= baseUsed.size()) baseUsed.resize(b + 1,false);
+		baseUsed[b] = true;
+		if (b > maxBase) maxBase = b;
+		rowBase[r] = (uint32_t)b;
+	}
+
+	/*
+	 *	Build the arrays. Unused slots are checked against a value past
+	 *	any base, so they never match.
+	 */
+
+	size = maxBase + width + 1;
+	next = (uint32_t *)malloc(sizeof(uint32_t) * size);
+	check = (uint32_t *)malloc(sizeof(uint32_t) * size);
+	for (i = 0; i < size; ++i) {
+		next[i] = illegal;
+		check[i] = (uint32_t)size;
+	}
+
+	for (i = 0; i < len; ++i) {
+		const uint32_t *row = states + rows[i] * width;
+		uint32_t b = rowBase[i];
+		for (x = 0; x < width; ++x) {
+			if (row[x] != illegal) {
+				next[b + x] = row[x];
+				check[b + x] = b;
+			}
+		}
+	}
+
+	for (y = 0; y < height; ++y) {
+		base[y] = rowBase[rowOf[y]];
+	}
+}
+
+/*	OCCombStates::~OCCombStates
+ *
+ *		Delete allocated memory
+ */
+
+OCCombStates::~OCCombStates()
+{
+	free(base);
+	free(next);
+	free(check);
+}
@@ -9,8 +9,143 @@
 #include <stdio.h>
 #include "OCUtilities.h"
 #include <new>
+#include <utility>
 #include <string.h>
 
+/************************************************************************/
+/*																		*/
+/*	Internal Support													*/
+/*																		*/
+/************************************************************************/
+
+/*	Mix
+ *
+ *		Scramble a single item for hashing. This is the splitmix64 finalizer.
+ *	The hash of a set is the sum of the mixed values of its items, so it
+ *	does not depend on the representation of the set.
+ */
+
+static inline uint64_t Mix(uint32_t val)
+{
+	uint64_t z = val + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*	OCIntegerSet::GrowList
+ *
+ *		Make sure the sorted list can hold len items.
+ */
+
+void OCIntegerSet::GrowList(size_t len)
+{
+	if (alloc < len) {
+		size_t newAlloc = (len + 15) & ~15;		// next 16 object boundary
+		uint32_t *tmp = (uint32_t *)realloc(list,sizeof(uint32_t) * newAlloc);
+		if (tmp == NULL) throw std::bad_alloc();
+
+		alloc = newAlloc;
+		list = tmp;
+	}
+}
+
+/*	OCIntegerSet::MakeDense
+ *
+ *		Convert to (or rebase) the bitset representation so that it covers
+ *	all of the items from min to max. The current contents of the set must
+ *	already fall within that range.
+ */
+
+void OCIntegerSet::MakeDense(uint32_t min, uint32_t max)
+{
+	uint32_t lo = min & ~63U;
+	size_t nw = (size_t)((max - lo) >> 6) + 1;
+
+	if (!dense && (bitAlloc >= nw)) {
+		/*
+		 *	Reuse the bitset left over from the last time we were dense
+		 */
+
+		memset(bits,0,sizeof(uint64_t) * nw);
+		for (size_t i = 0; i < size; ++i) {
+			uint32_t off = list[i] - lo;
+			bits[off >> 6] |= 1ULL << (off & 63);
+		}
+	} else {
+		uint64_t *tmp = (uint64_t *)calloc(nw,sizeof(uint64_t));
+		if (tmp == NULL) throw std::bad_alloc();
+
+		if (dense) {
+			memmove(tmp + ((base - lo) >> 6),bits,sizeof(uint64_t) * words);
+		} else {
+			for (size_t i = 0; i < size; ++i) {
+				uint32_t off = list[i] - lo;
+				tmp[off >> 6] |= 1ULL << (off & 63);
+			}
+		}
+
+		if (bits) free(bits);
+		bits = tmp;
+		bitAlloc = nw;
+	}
+
+	base = lo;
+	words = nw;
+	dense = true;
+}
+
+/*	OCIntegerSet::MakeSorted
+ *
+ *		Convert from the bitset representation to a sorted list
+ */
+
+void OCIntegerSet::MakeSorted()
+{
+	if (!dense) return;
+
+	GrowList(size);
+
+	Iterator iter(*this);
+	uint32_t val;
+	size_t p = 0;
+	while (iter.Next(val)) {
+		list[p++] = val;
+	}
+
+	dense = false;
+}
+
+/*	OCIntegerSet::CheckDensity
+ *
+ *		Switch the sorted list to a bitset once the bitset would take no
+ *	more than half the memory. Small sets always stay as a list.
+ */
+
+void OCIntegerSet::CheckDensity()
+{
+	if (dense || (size < 32)) return;
+
+	uint64_t range = (uint64_t)list[size-1] - list[0] + 1;
+	if (range <= 16 * (uint64_t)size) {
+		MakeDense(list[0],list[size-1]);
+	}
+}
+
+/*	OCIntegerSet::CountBits
+ *
+ *		Recalculate the size of the bitset representation
+ */
+
+void OCIntegerSet::CountBits()
+{
+	size_t count = 0;
+	for (size_t w = 0; w < words; ++w) {
+		count += (size_t)__builtin_popcountll(bits[w]);
+	}
+	size = count;
+}
+
 /************************************************************************/
 /*																		*/
 /*	Construction/Destruction											*/
@@ -28,6 +163,15 @@ OCIntegerSet::OCIntegerSet()
 	alloc = 16;
 	list = (uint32_t *)malloc(sizeof(uint32_t) * alloc);
 	if (list == NULL) throw std::bad_alloc();
+
+	dense = false;
+	base = 0;
+	words = 0;
+	bitAlloc = 0;
+	bits = NULL;
+
+	hashed = false;
+	hash = 0;
 }
 
 /*	OCIntegerSet::~OCIntegerSet
@@ -38,6 +182,7 @@ OCIntegerSet::OCIntegerSet()
 OCIntegerSet::~OCIntegerSet()
 {
 	if (list) free(list);
+	if (bits) free(bits);
 }
 
 /*	OCIntegerSet::OCIntegerSet
@@ -49,12 +194,57 @@ OCIntegerSet::~OCIntegerSet()
 OCIntegerSet::OCIntegerSet(const OCIntegerSet &set)
 {
 	size = set.size;
-	alloc = set.size;
+	dense = set.dense;
+	base = set.base;
+	hashed = set.hashed;
+	hash = set.hash;
+
+	alloc = dense ? 1 : set.size;
 	if (alloc < 1) alloc = 1;
 
 	list = (uint32_t *)malloc(sizeof(uint32_t) * alloc);
 	if (list == NULL) throw std::bad_alloc();
-	memmove(list,set.list,sizeof(uint32_t) * size);
+
+	if (dense) {
+		words = set.words;
+		bitAlloc = set.words;
+		bits = (uint64_t *)malloc(sizeof(uint64_t) * bitAlloc);
+		if (bits == NULL) throw std::bad_alloc();
+		memmove(bits,set.bits,sizeof(uint64_t) * words);
+	} else {
+		words = 0;
+		bitAlloc = 0;
+		bits = NULL;
+		memmove(list,set.list,sizeof(uint32_t) * size);
+	}
+}
+
+/*	OCIntegerSet::OCIntegerSet
+ *
+ *		Move constructor. Takes ownership of the other set's storage
+ */
+
+OCIntegerSet::OCIntegerSet(OCIntegerSet &&set)
+{
+	size = set.size;
+	alloc = set.alloc;
+	list = set.list;
+	dense = set.dense;
+	base = set.base;
+	words = set.words;
+	bitAlloc = set.bitAlloc;
+	bits = set.bits;
+	hashed = set.hashed;
+	hash = set.hash;
+
+	set.size = 0;
+	set.alloc = 0;
+	set.list = NULL;
+	set.dense = false;
+	set.words = 0;
+	set.bitAlloc = 0;
+	set.bits = NULL;
+	set.hashed = false;
 }
 
 /*	OCIntegerSet::operator =
@@ -64,16 +254,58 @@ OCIntegerSet::OCIntegerSet(const OCIntegerSet &set)
 
 OCIntegerSet &OCIntegerSet::operator =(const OCIntegerSet &set)
 {
-	if (alloc < set.size) {
-		uint32_t *tmp = (uint32_t *)realloc(list,sizeof(uint32_t) * set.size);
-		if (tmp == NULL) throw std::bad_alloc();
+	if (this == &set) return *this;
 
-		alloc = set.size;
-		list = tmp;
+	if (set.dense) {
+		if (bitAlloc < set.words) {
+			uint64_t *tmp = (uint64_t *)realloc(bits,sizeof(uint64_t) * set.words);
+			if (tmp == NULL) throw std::bad_alloc();
+
+			bitAlloc = set.words;
+			bits = tmp;
+		}
+
+		base = set.base;
+		words = set.words;
+		memmove(bits,set.bits,sizeof(uint64_t) * words);
+	} else {
+		if (alloc < set.size) {
+			uint32_t *tmp = (uint32_t *)realloc(list,sizeof(uint32_t) * set.size);
+			if (tmp == NULL) throw std::bad_alloc();
+
+			alloc = set.size;
+			list = tmp;
+		}
+
+		memmove(list,set.list,sizeof(uint32_t) * set.size);
 	}
 
 	size = set.size;
-	memmove(list,set.list,sizeof(uint32_t) * size);
+	dense = set.dense;
+	hashed = set.hashed;
+	hash = set.hash;
+
+	return *this;
+}
+
+/*	OCIntegerSet::operator =
+ *
+ *		Move operator. We swap storage with the other set, which will
+ *	release ours when it is destroyed
+ */
+
+OCIntegerSet &OCIntegerSet::operator =(OCIntegerSet &&set)
+{
+	std::swap(size,set.size);
+	std::swap(alloc,set.alloc);
+	std::swap(list,set.list);
+	std::swap(dense,set.dense);
+	std::swap(base,set.base);
+	std::swap(words,set.words);
+	std::swap(bitAlloc,set.bitAlloc);
+	std::swap(bits,set.bits);
+	std::swap(hashed,set.hashed);
+	std::swap(hash,set.hash);
 
 	return *this;
 }
@@ -84,6 +316,30 @@ OCIntegerSet &OCIntegerSet::operator =(const OCIntegerSet &set)
 /*																		*/
 /************************************************************************/
 
+/*	OCIntegerSet::Hash
+ *
+ *		Return the hash of this set, calculating it if needed
+ */
+
+uint64_t OCIntegerSet::Hash() const
+{
+	if (!hashed) {
+		uint64_t h = 0;
+
+		if (dense) {
+			Iterator iter(*this);
+			uint32_t val;
+			while (iter.Next(val)) h += Mix(val);
+		} else {
+			for (size_t i = 0; i < size; ++i) h += Mix(list[i]);
+		}
+
+		hash = h;
+		hashed = true;
+	}
+	return hash;
+}
+
 /*	OCIntegerSet::operator ==
  *
  *		Return true if two items are equal
@@ -92,11 +348,29 @@ OCIntegerSet &OCIntegerSet::operator =(const OCIntegerSet &set)
 bool OCIntegerSet::operator == (const OCIntegerSet &set) const
 {
 	if (size != set.size) return false;
+	if (hashed && set.hashed && (hash != set.hash)) return false;
+
+	/*
+	 *	Sets with the same representation and layout compare as a block
+	 */
 
-	for (size_t i = 0; i < size; ++i) {
-		if (list[i] != set.list[i]) return false;
+	if (!dense && !set.dense) {
+		return 0 == memcmp(list,set.list,sizeof(uint32_t) * size);
+	}
+	if (dense && set.dense && (base == set.base) && (words == set.words)) {
+		return 0 == memcmp(bits,set.bits,sizeof(uint64_t) * words);
 	}
 
+	/*
+	 *	Otherwise walk both
+	 */
+
+	Iterator a(*this);
+	Iterator b(set);
+	uint32_t av,bv;
+	while (a.Next(av)) {
+		if (!b.Next(bv) || (av != bv)) return false;
+	}
 	return true;
 }
 
@@ -109,18 +383,62 @@ bool OCIntegerSet::operator == (const OCIntegerSet &set) const
 
 bool OCIntegerSet::operator < (const OCIntegerSet &set) const
 {
-	size_t i;
+	Iterator a(*this);
+	Iterator b(set);
+	uint32_t av,bv;
+
+	for (;;) {
+		bool aok = a.Next(av);
+		bool bok = b.Next(bv);
+
+		/* If we get here the prefixes are the same. Return true if the
+		 * first list is shorter than the second
+		 */
+
+		if (!aok || !bok) return bok;
 
-	for (i = 0; (i < size) && (i < set.size); ++i) {
-		if (list[i] < set.list[i]) return true;
-		if (list[i] > set.list[i]) return false;
+		if (av < bv) return true;
+		if (av > bv) return false;
 	}
+}
 
-	/* If we get here the prefixes are the same. Return true if the first
-	 * list is shorter than the second
-	 */
+/************************************************************************/
+/*																		*/
+/*	Access																*/
+/*																		*/
+/************************************************************************/
 
-	return size < set.size;
+/*	OCIntegerSet::Iterator::Iterator
+ *
+ *		Start iterating the set
+ */
+
+OCIntegerSet::Iterator::Iterator(const OCIntegerSet &s) : set(s)
+{
+	pos = 0;
+	word = (s.dense && s.words) ? s.bits[0] : 0;
+}
+
+/*	OCIntegerSet::Item
+ *
+ *		Return the item at the index provided. For the bitset this scans
+ *	the bits up to the item.
+ */
+
+uint32_t OCIntegerSet::Item(size_t index) const
+{
+	if (!dense) return list[index];
+
+	for (size_t w = 0; w < words; ++w) {
+		uint64_t word = bits[w];
+		size_t count = (size_t)__builtin_popcountll(word);
+		if (index < count) {
+			while (index-- > 0) word &= word - 1;
+			return base + (uint32_t)(w * 64) + (uint32_t)__builtin_ctzll(word);
+		}
+		index -= count;
+	}
+	return 0;		// out of range
 }
 
 /************************************************************************/
@@ -135,8 +453,15 @@ bool OCIntegerSet::operator < (const OCIntegerSet &set) const
  *	to minimize the time it takes to find our item
  */
 
-bool OCIntegerSet::Contains(uint32_t val)
+bool OCIntegerSet::Contains(uint32_t val) const
 {
+	if (dense) {
+		if (val < base) return false;
+		uint32_t off = val - base;
+		if ((off >> 6) >= words) return false;
+		return 0 != (bits[off >> 6] & (1ULL << (off & 63)));
+	}
+
 	size_t min = 0;
 	size_t max = size;
 	size_t mid;
@@ -162,60 +487,129 @@ bool OCIntegerSet::Contains(uint32_t val)
 
 void OCIntegerSet::Add(uint32_t val)
 {
-	/*
-	 *	Is this already contained? If so, skip the rest. We do a containment
-	 *	test first, as that is O(log(N)), and we'd have to run a scan of
-	 *	the table twice at O(N) in order to implicitly determine if the item
-	 *	was contained.
-	 */
-
-	if (Contains(val)) return;
-
-	/*
-	 *	First, make sure we can add by resizing.
-	 */
-
-	if (alloc == size) {
+	if (dense) {
 		/*
-		 *	Grow our memory pool
+		 *	Extend the bitset if this item falls outside of it. If the
+		 *	result would be too sparse, drop back to a sorted list.
 		 */
 
-		size_t newAlloc = (alloc + 16) & ~15;	// next 16 object boundary
-		uint32_t *tmp = (uint32_t *)realloc(list,sizeof(uint32_t) * newAlloc);
-		if (tmp == NULL) throw std::bad_alloc();
+		uint32_t off = val - base;
+		if ((val < base) || ((off >> 6) >= words)) {
+			uint32_t min = (val < base) ? val : base;
+			uint32_t max = base + (uint32_t)(words * 64 - 1);
+			if (val > max) max = val;
+
+			if ((uint64_t)max - min + 1 > 64 * ((uint64_t)size + 1)) {
+				MakeSorted();
+			} else {
+				MakeDense(min,max);
+				off = val - base;
+			}
+		}
 
-		alloc = newAlloc;
-		list = tmp;
+		if (dense) {
+			uint64_t mask = 1ULL << (off & 63);
+			if (0 == (bits[off >> 6] & mask)) {
+				bits[off >> 6] |= mask;
+				++size;
+				hashed = false;
+			}
+			return;
+		}
 	}
 
 	/*
-	 *	Now run the list from the top to insert
+	 *	Find the insertion point. Items are often added in ascending
+	 *	order, so check the end of the list first.
 	 */
 
-	bool insert = false;
-	for (size_t off = size; off > 0; --off) {
-		uint32_t tmp = list[off-1];
-		if (tmp > val) {
-			list[off] = tmp;
-		} else {
-			list[off] = val;
-			insert = true;
-			break;
+	size_t min = size;
+	if ((size > 0) && (val <= list[size-1])) {
+		size_t max = size;
+		min = 0;
+		while (min < max) {
+			size_t mid = (min + max)/2;
+			if (list[mid] < val) {
+				min = mid+1;
+			} else {
+				max = mid;
+			}
 		}
+		if (list[min] == val) return;
 	}
-	if (!insert) {
-		list[0] = val;
-	}
+
+	GrowList(size + 1);
+	memmove(list + min + 1,list + min,sizeof(uint32_t) * (size - min));
+	list[min] = val;
 	++size;
+	hashed = false;
+
+	CheckDensity();
 }
 
 /*	OCIntegerSet::AddSet
  *
- *		Add set. This folds two lists together in linear time
+ *		Add set. This folds two lists together in linear time, or ORs the
+ *	two bitsets together.
  */
 
 void OCIntegerSet::AddSet(const OCIntegerSet &set)
 {
+	if ((set.size == 0) || (this == &set)) return;
+
+	if (dense || set.dense) {
+		/*
+		 *	Find the range covered by the union. If it is dense enough,
+		 *	make sure our bitset covers it and merge into that.
+		 */
+
+		uint32_t min = set.dense ? set.base : set.list[0];
+		uint32_t max = set.dense ? set.base + (uint32_t)(set.words * 64 - 1) : set.list[set.size-1];
+		if (size > 0) {
+			uint32_t tmin = dense ? base : list[0];
+			uint32_t tmax = dense ? base + (uint32_t)(words * 64 - 1) : list[size-1];
+			if (min > tmin) min = tmin;
+			if (max < tmax) max = tmax;
+		}
+
+		if ((uint64_t)max - min + 1 <= 64 * ((uint64_t)size + set.size)) {
+			if (!dense || (min < base) || (max > base + words * 64 - 1)) {
+				if (size == 0) dense = false;		// nothing to preserve
+				MakeDense(min,max);
+			}
+
+			if (set.dense) {
+				uint64_t *d = bits + ((set.base - base) >> 6);
+				const uint64_t *s = set.bits;
+				size_t w,len = set.words;
+				for (w = 0; w < len; ++w) {
+					d[w] |= s[w];
+				}
+			} else {
+				for (size_t i = 0; i < set.size; ++i) {
+					uint32_t off = set.list[i] - base;
+					bits[off >> 6] |= 1ULL << (off & 63);
+				}
+			}
+
+			CountBits();
+			hashed = false;
+			return;
+		}
+
+		/*
+		 *	Too sparse. Fold the lists together below.
+		 */
+
+		MakeSorted();
+		if (set.dense) {
+			OCIntegerSet tmp(set);
+			tmp.MakeSorted();
+			AddSet(tmp);
+			return;
+		}
+	}
+
 	/*
 	 *	First, make sure we have enough for the worst case scenario of
 	 *	two lists
@@ -259,6 +653,9 @@ void OCIntegerSet::AddSet(const OCIntegerSet &set)
 			--a;
 		}
 	}
+	while (b > 0) {
+		list[--d] = set.list[--b];
+	}
 	while (a > 0) {
 		list[--d] = list[--a];
 	}
@@ -267,6 +664,27 @@ void OCIntegerSet::AddSet(const OCIntegerSet &set)
 	if (d > 0) {
 		memmove(list, list + d, size * sizeof(uint32_t));
 	}
+	hashed = false;
+
+	CheckDensity();
+}
+
+/*	OCIntegerSet::Assign
+ *
+ *		Replace the contents of this set with the list of items provided.
+ *	The items must already be sorted and contain no duplicates.
+ */
+
+void OCIntegerSet::Assign(const uint32_t *items, size_t len)
+{
+	GrowList(len);
+
+	size = len;
+	dense = false;
+	hashed = false;
+	if (len > 0) memmove(list,items,sizeof(uint32_t) * len);
+
+	CheckDensity();
 }
 
 /*	OCIntegerSet::Remove
@@ -277,6 +695,14 @@ void OCIntegerSet::AddSet(const OCIntegerSet &set)
 void OCIntegerSet::Remove(uint32_t val)
 {
 	if (!Contains(val)) return;
+	hashed = false;
+
+	if (dense) {
+		uint32_t off = val - base;
+		bits[off >> 6] &= ~(1ULL << (off & 63));
+		--size;
+		return;
+	}
 
 	// Find the index of the item to remove
 	size_t a = 0;
@@ -286,10 +712,7 @@ void OCIntegerSet::Remove(uint32_t val)
 	}
 
 	// Compress the rest of the list
-	while (a < size) {
-		list[a] = list[a+1];
-		++a;
-	}
+	memmove(list + a,list + a + 1,sizeof(uint32_t) * (size - a - 1));
 	--size;
 }
 
@@ -300,10 +723,55 @@ void OCIntegerSet::Remove(uint32_t val)
 
 void OCIntegerSet::RemoveSet(const OCIntegerSet &set)
 {
+	if (set.size == 0) return;
+	hashed = false;
+
+	if (dense) {
+		if (set.dense) {
+			/*
+			 *	Clear the bits over the range the two bitsets overlap
+			 */
+
+			uint32_t lo = (base > set.base) ? base : set.base;
+			uint64_t end = base + (uint64_t)words * 64;
+			uint64_t send = set.base + (uint64_t)set.words * 64;
+			if (end > send) end = send;
+
+			if (lo < end) {
+				uint64_t *d = bits + ((lo - base) >> 6);
+				const uint64_t *s = set.bits + ((lo - set.base) >> 6);
+				size_t w,len = (size_t)((end - lo) >> 6);
+				for (w = 0; w < len; ++w) {
+					d[w] &= ~s[w];
+				}
+			}
+		} else {
+			for (size_t i = 0; i < set.size; ++i) {
+				uint32_t val = set.list[i];
+				if (val < base) continue;
+				uint32_t off = val - base;
+				if ((off >> 6) >= words) break;
+				bits[off >> 6] &= ~(1ULL << (off & 63));
+			}
+		}
+
+		CountBits();
+		return;
+	}
+
 	size_t a = 0;
 	size_t b = 0;
 	size_t p = 0;
 
+	if (set.dense) {
+		while (a < size) {
+			if (!set.Contains(list[a])) list[p++] = list[a];
+			++a;
+		}
+		size = p;
+		return;
+	}
+
 	/*
 	 *	Copy, but drop items that are in both.
 	 */
@@ -350,15 +818,19 @@ std::string OCIntegerSet::ToString()
 	std::string str;
 
 	str.push_back('[');
-	for (size_t i = 0; i < size; ++i) {
-		if (i) str.push_back(',');
+
+	Iterator iter(*this);
+	uint32_t val;
+	bool first = true;
+	while (iter.Next(val)) {
+		if (!first) str.push_back(',');
+		first = false;
 
 		char buffer[256];
-		sprintf(buffer,"%u",list[i]);
+		sprintf(buffer,"%u",val);
 		str.append(buffer);
 	}
 	str.push_back(']');
 
 	return str;
 }
-
@@ -0,0 +1,133 @@
+//
+//  OCIntegerSetMap.cpp
+//  occommon
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include "OCUtilities.h"
+
+/************************************************************************/
+/*																		*/
+/*	Construction/Destruction											*/
+/*																		*/
+/************************************************************************/
+
+/*	OCIntegerSetMap::OCIntegerSetMap
+ *
+ *		Construct an empty map
+ */
+
+OCIntegerSetMap::OCIntegerSetMap()
+{
+}
+
+/*	OCIntegerSetMap::~OCIntegerSetMap
+ *
+ *		Delete the map
+ */
+
+OCIntegerSetMap::~OCIntegerSetMap()
+{
+}
+
+/*	OCIntegerSetMap::Clear
+ *
+ *		Remove all of the sets from the map
+ */
+
+void OCIntegerSetMap::Clear()
+{
+	sets.clear();
+	hashes.clear();
+	slots.clear();
+}
+
+/************************************************************************/
+/*																		*/
+/*	Lookup																*/
+/*																		*/
+/************************************************************************/
+
+/*	OCIntegerSetMap::Grow
+ *
+ *		Double the size of the slot table and reinsert our sets. The table
+ *	is kept at most half full, so probe sequences stay short.
+ */
+
+void OCIntegerSetMap::Grow()
+{
+	size_t len = slots.size() * 2;
+	if (len < 64) len = 64;
+
+	slots.assign(len,0);
+
+	size_t mask = len - 1;
+	uint32_t i,n = (uint32_t)sets.size();
+	for (i = 0; i < n; ++i) {
+		size_t s = (size_t)hashes[i] & mask;
+		while (slots[s] != 0) s = (s + 1) & mask;
+		slots[s] = i + 1;
+	}
+}
+
+/*	OCIntegerSetMap::Find
+ *
+ *		Find the index of the set. Returns false if the set is not in
+ *	the map.
+ */
+
+bool OCIntegerSetMap::Find(const OCIntegerSet &set, uint32_t &index) const
+{
+	if (slots.empty()) return false;
+
+	uint64_t hash = set.Hash();
+	size_t mask = slots.size() - 1;
+	size_t s = (size_t)hash & mask;
+
+	for (;;) {
+		uint32_t slot = slots[s];
+		if (slot == 0) return false;
+
+		if ((hashes[slot-1] == hash) && (sets[slot-1] == set)) {
+			index = slot - 1;
+			return true;
+		}
+		s = (s + 1) & mask;
+	}
+}
+
+/*	OCIntegerSetMap::Intern
+ *
+ *		Find the index of the set, adding it to the end of our list of
+ *	sets if it is not present.
+ */
+
+uint32_t OCIntegerSetMap::Intern(const OCIntegerSet &set, bool &added)
+{
+	if (slots.size() < 2 * (sets.size() + 1)) Grow();
+
+	uint64_t hash = set.Hash();
+	size_t mask = slots.size() - 1;
+	size_t s = (size_t)hash & mask;
+
+	for (;;) {
+		uint32_t slot = slots[s];
+		if (slot == 0) break;
+
+		if ((hashes[slot-1] == hash) && (sets[slot-1] == set)) {
+			added = false;
+			return slot - 1;
+		}
+		s = (s + 1) & mask;
+	}
+
+	uint32_t index = (uint32_t)sets.size();
+	sets.push_back(set);
+	hashes.push_back(hash);
+	slots[s] = index + 1;
+
+	added = true;
+	return index;
+}
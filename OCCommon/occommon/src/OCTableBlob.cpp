@@ -0,0 +1,109 @@
+//
+//  OCTableBlob.cpp
+//  occommon
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <stdio.h>
+#include "OCUtilities.h"
+
+/************************************************************************/
+/*																		*/
+/*	Construction/Destruction											*/
+/*																		*/
+/************************************************************************/
+
+OCTableBlob::OCTableBlob()
+{
+	checked = false;
+}
+
+OCTableBlob::~OCTableBlob()
+{
+}
+
+/************************************************************************/
+/*																		*/
+/*	Tables																*/
+/*																		*/
+/************************************************************************/
+
+/*	OCTableBlob::WriteTable
+ *
+ *		Write a table of len values, each width bytes wide, as a string. A
+ *	table of bytes is an array initialized from the string. A wider table
+ *	is a constant object whose operator[] copies its value out of the
+ *	string, so the generated code indexes it just as it would the array.
+ *	Signed values are passed as their two's complement, and the low width
+ *	bytes are stored.
+ */
+
+void OCTableBlob::WriteTable(FILE *f, const char *name, const uint32_t *list, size_t len,
+							 size_t width, bool isSigned)
+{
+	if (width == 1) {
+		fprintf(f,"static const %s %s[%zu] =",isSigned ? "int8_t" : "uint8_t",name,len + 1);
+		WriteString(f,list,len,width,"\n    ");
+		fprintf(f,";\n\n");
+		return;
+	}
+
+	const char *type;
+	if (width == 2) {
+		type = isSigned ? "int16_t" : "uint16_t";
+	} else {
+		type = isSigned ? "int32_t" : "uint32_t";
+	}
+
+	if (!checked) {
+		checked = true;
+		fprintf(f,"#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)\n");
+		fprintf(f,"#error The tables below are stored little-endian\n");
+		fprintf(f,"#endif\n\n");
+	}
+
+	fprintf(f,"static const struct {\n");
+	fprintf(f,"    %s operator[](size_t i) const\n",type);
+	fprintf(f,"    {\n");
+	fprintf(f,"        static const unsigned char data[%zu] =",len * width + 1);
+	WriteString(f,list,len,width,"\n            ");
+	fprintf(f,";\n");
+	fprintf(f,"        %s v;\n",type);
+	fprintf(f,"        memcpy(&v,data + i * sizeof(v),sizeof(v));\n");
+	fprintf(f,"        return v;\n");
+	fprintf(f,"    }\n");
+	fprintf(f,"} %s = {};\n\n",name);
+}
+
+/*	OCTableBlob::WriteString
+ *
+ *		Write the values as a string literal, width bytes each, stored
+ *	little-endian, with 32 bytes on each line after the indent.
+ */
+
+void OCTableBlob::WriteString(FILE *f, const uint32_t *list, size_t len, size_t width,
+							  const char *indent)
+{
+	size_t i,j,n = 0;
+
+	if (len == 0) {
+		fprintf(f,"%s\"\"",indent);
+		return;
+	}
+
+	for (i = 0; i < len; ++i) {
+		uint32_t value = list[i];
+		for (j = 0; j < width; ++j) {
+			if ((n % 32) == 0) {
+				if (n) fprintf(f,"\"");
+				fprintf(f,"%s\"",indent);
+			}
+			fprintf(f,"\\x%02x",value & 0xFF);
+			value >>= 8;
+			++n;
+		}
+	}
+	fprintf(f,"\"");
+}
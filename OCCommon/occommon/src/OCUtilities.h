@@ -10,7 +10,9 @@
 #define OCUtilities_h
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
 #include <map>
 
 /************************************************************************/
@@ -48,6 +50,12 @@ class OCAlloc
 /*	OCIntegerSet
  *
  *		Represents a set of 32-bit integers. Used when building NFAs
+ *
+ *		The set is stored either as a sorted list of items or, once the
+ *	items are dense enough that it takes less memory, as a bitset covering
+ *	the range of items. The representation is switched automatically; the
+ *	two forms compare equal and hash identically. Item(index) is constant
+ *	time only for the sorted form, so use Iterator to walk the contents.
  */
 
 class OCIntegerSet
@@ -55,9 +63,11 @@ class OCIntegerSet
 	public:
 		OCIntegerSet();
 		OCIntegerSet(const OCIntegerSet &set);
+		OCIntegerSet(OCIntegerSet &&set);
 		~OCIntegerSet();
 
 		OCIntegerSet &operator = (const OCIntegerSet &set);
+		OCIntegerSet &operator = (OCIntegerSet &&set);
 
 		bool operator == (const OCIntegerSet &set) const;
 		bool operator < (const OCIntegerSet &set) const;	// for use in map
@@ -68,12 +78,15 @@ class OCIntegerSet
 
 		void Add(uint32_t val);
 		void AddSet(const OCIntegerSet &set);
+		void Assign(const uint32_t *items, size_t len);	// sorted, unique
 
-		bool Contains(uint32_t val);
+		bool Contains(uint32_t val) const;
 
 		void RemoveAll()
 			{
 				size = 0;
+				dense = false;
+				hashed = false;
 			}
 		void Remove(uint32_t val);
 		void RemoveSet(const OCIntegerSet &set);
@@ -82,10 +95,49 @@ class OCIntegerSet
 			{
 				return size;
 			}
-		uint32_t Item(size_t index) const
-			{
-				return list[index];
-			}
+		uint32_t Item(size_t index) const;
+
+		/*
+		 *	64-bit hash of the contents. This is computed on demand and
+		 *	cached until the set is next modified.
+		 */
+
+		uint64_t Hash() const;
+
+		/*
+		 *	Walk the items of the set in ascending order:
+		 *
+		 *		OCIntegerSet::Iterator iter(set);
+		 *		uint32_t val;
+		 *		while (iter.Next(val)) ...
+		 */
+
+		class Iterator
+		{
+			public:
+				Iterator(const OCIntegerSet &set);
+
+				bool Next(uint32_t &val)
+					{
+						if (!set.dense) {
+							if (pos >= set.size) return false;
+							val = set.list[pos++];
+							return true;
+						}
+						while (word == 0) {
+							if (++pos >= set.words) return false;
+							word = set.bits[pos];
+						}
+						val = set.base + (uint32_t)(pos * 64) + (uint32_t)__builtin_ctzll(word);
+						word &= word - 1;
+						return true;
+					}
+
+			private:
+				const OCIntegerSet &set;
+				size_t pos;
+				uint64_t word;
+		};
 
 		std::string ToString();
 
@@ -93,6 +145,61 @@ class OCIntegerSet
 		size_t alloc;
 		size_t size;
 		uint32_t *list;		// Sorted list of integer items
+
+		bool dense;			// true if the items are stored in bits
+		uint32_t base;		// first item covered by bits; multiple of 64
+		size_t words;		// number of words of bits in use
+		size_t bitAlloc;
+		uint64_t *bits;
+
+		mutable bool hashed;
+		mutable uint64_t hash;
+
+		void GrowList(size_t len);
+		void MakeDense(uint32_t min, uint32_t max);
+		void MakeSorted();
+		void CheckDensity();
+		void CountBits();
+};
+
+/*	OCIntegerSetMap
+ *
+ *		Interns integer sets, assigning each distinct set an index in the
+ *	order they were added. This is an open addressing hash table keyed on
+ *	the cached hash of each set, used to map NFA state sets to DFA states.
+ */
+
+class OCIntegerSetMap
+{
+	public:
+		OCIntegerSetMap();
+		~OCIntegerSetMap();
+
+		void Clear();
+
+		/*
+		 *	Find the index of the set, adding it if not present. Sets
+		 *	added to the map are numbered sequentially from zero.
+		 */
+
+		uint32_t Intern(const OCIntegerSet &set, bool &added);
+		bool Find(const OCIntegerSet &set, uint32_t &index) const;
+
+		size_t Size() const
+			{
+				return sets.size();
+			}
+		const OCIntegerSet &Item(uint32_t index) const
+			{
+				return sets[index];
+			}
+
+	private:
+		std::vector<OCIntegerSet> sets;
+		std::vector<uint64_t> hashes;		// hash of each set
+		std::vector<uint32_t> slots;		// index + 1 of each set, or 0
+
+		void Grow();
 };
 
 /************************************************************************/
@@ -129,6 +236,74 @@ class OCCompressStates
 		uint32_t *a;
 };
 
+/*	OCCombStates
+ *
+ *		Given an input array and the dimensions of the array, this generates
+ *	a compressed state machine using row displacement: the rows are
+ *	overlaid on each other in a single array, each offset by its own base
+ *	so that none of their entries collide. The entry for (x,y) is next[i]
+ *	where i = base[y] + x, provided check[i] == base[y]; otherwise it is
+ *	illegal. Identical rows share the same base.
+ *
+ *		Each row has a distinct base, and next and check have room past the
+ *	last base for a full row plus one, so any x up to and including width
+ *	may be looked up.
+ */
+
+class OCCombStates
+{
+	public:
+		// States are in row major format
+		OCCombStates(size_t width, size_t height, uint32_t *states, uint32_t illegal);
+		~OCCombStates();
+
+		/*
+		 *	Values calculated on construction
+		 */
+
+		size_t bsize;
+		uint32_t *base;
+
+		size_t size;
+		uint32_t *next;
+		uint32_t *check;
+};
+
+/************************************************************************/
+/*																		*/
+/*	Table Blob															*/
+/*																		*/
+/************************************************************************/
+
+/*	OCTableBlob
+ *
+ *		Writes the tables for a generated C++ file as string literals. A
+ *	compiler reads a string literal much faster than a long list of
+ *	integers. A table of bytes is a uint8_t array initialized from its
+ *	string. Each wider table is a constant object with a typed operator[]
+ *	which copies its value out of the string, so the generated code
+ *	indexes it just as it would the array, without reading the string
+ *	through a pointer of another type.
+ *
+ *		Values are stored little-endian.
+ */
+
+class OCTableBlob
+{
+	public:
+		OCTableBlob();
+		~OCTableBlob();
+
+		void WriteTable(FILE *f, const char *name, const uint32_t *list, size_t len,
+						size_t width, bool isSigned = false);
+
+	private:
+		void WriteString(FILE *f, const uint32_t *list, size_t len, size_t width,
+						 const char *indent);
+
+		bool checked;					// byte order check written
+};
+
 /************************************************************************/
 /*																		*/
 /*	Replacment Support													*/
@@ -159,4 +334,18 @@ class OCTextReplace
 		void write(const char *text, FILE *f);
 };
 
+/************************************************************************/
+/*																		*/
+/*	Argument Support													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCParseNumber
+ *
+ *		Parse a command line number between min and max, used by the tools
+ *	which share this library
+ */
+
+extern bool OCParseNumber(const char *str, long min, long max, long &value);
+
 #endif /* OCUtilities_h */
@@ -0,0 +1,689 @@
+//
+//  OCLexBench.cpp
+//  oclexbench
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <set>
+#include <string>
+
+#include "OCLexParser.h"
+#include "OCLexCPPGenerator.h"
+#include <OCUtilities.h>
+
+static const char *GHelp =
+	"oclexbench\n"                                                            \
+	"\n"                                                                      \
+	"    Measures how long oclex takes to generate a C++ lexer. This builds lex\n" \
+	"specs of increasing size and, for each, times parsing the spec, building\n" \
+	"the NFA, building the DFA and writing the output files. The results are\n" \
+	"written to stdout as JSON.\n"                                            \
+	"\n"                                                                      \
+	"Usage: oclexbench [-h] [-j threads] [-f family] [-o directory] [-r]\n"   \
+	"\n"                                                                      \
+	"-h  Prints this help file.\n"                                            \
+	"\n"                                                                      \
+	"-j  Number of threads used to build the DFA. Defaults to 1.\n"           \
+	"\n"                                                                      \
+	"-f  Only run one family of specs: keywords, regex, nesting or states. Can\n" \
+	"    be given more than once. By default all are run.\n"                  \
+	"\n"                                                                      \
+	"-o  Write the generated specs to the directory, so they can be run through\n" \
+	"    oclex separately.\n"                                                 \
+	"\n"                                                                      \
+	"-r  Also compile each lexer with comb tables and as code, using the C++\n" \
+	"    compiler in $CXX (c++ by default), and time how fast each lexes a\n" \
+	"    sample of text. Lexers with more than 5000 states are skipped.\n";
+
+/************************************************************************/
+/*																		*/
+/*	Declarations														*/
+/*																		*/
+/************************************************************************/
+
+/*	Family
+ *
+ *		A family of specs. Each is built at each of the scales listed,
+ *	from smallest to largest.
+ */
+
+struct Family {
+	const char *name;
+	std::string (*build)(uint32_t scale);
+	uint32_t scales[4];
+};
+
+static uint32_t GThreads = 1;
+static std::set<std::string> GFamilies;
+static const char *GDirectory = NULL;
+static bool GRunLexers = false;
+
+#define MAXRUNSTATES	5000		// largest DFA compiled by -r
+#define RUNTEXTSIZE		4000000		// bytes of text lexed by -r
+
+/************************************************************************/
+/*																		*/
+/*	Spec Construction													*/
+/*																		*/
+/************************************************************************/
+
+/*	Word
+ *
+ *		Pseudo-random lower case word, from a simple LCG. The same seed
+ *	gives the same words on every run.
+ */
+
+static std::string Word(uint32_t &seed, uint32_t minLen, uint32_t maxLen)
+{
+	seed = seed * 1103515245 + 12345;
+	uint32_t len = minLen + (seed >> 16) % (maxLen - minLen + 1);
+
+	std::string ret;
+	for (uint32_t i = 0; i < len; ++i) {
+		seed = seed * 1103515245 + 12345;
+		ret.push_back((char)('a' + (seed >> 16) % 26));
+	}
+	return ret;
+}
+
+/*	Keywords
+ *
+ *		N distinct keywords, followed by identifiers, numbers and white
+ *	space, as a programming language would have.
+ */
+
+static std::string Keywords(uint32_t scale)
+{
+	std::string ret = "%%\n\n";
+	std::set<std::string> words;
+	uint32_t seed = 1;
+	char buffer[64];
+
+	while (words.size() < scale) {
+		std::string w = Word(seed,2,10);
+		if (!words.insert(w).second) continue;
+
+		snprintf(buffer,sizeof(buffer),"\t{ return %zu; }\n",words.size());
+		ret += "\"" + w + "\"" + buffer;
+	}
+
+	ret += "[a-zA-Z_][a-zA-Z0-9_]*\t{ return 1; }\n";
+	ret += "[0-9]+\t\t\t\t\t{ return 2; }\n";
+	ret += "[ \\t\\n]\t\t\t\t\t{ }\n";
+	ret += ".\t\t\t\t\t\t{ return 3; }\n";
+	return ret;
+}
+
+/*	Regex
+ *
+ *		N rules which each start with a distinct word, followed by
+ *	repeated character classes and optional parts.
+ */
+
+static std::string Regex(uint32_t scale)
+{
+	static const char *tails[] = {
+		"[0-9]+(\\.[0-9]+)?",
+		"[a-f0-9]*\"h\"",
+		"(\"-\"|\"+\")[a-z]+",
+		"[A-Z][a-z]*(_[A-Z][a-z]*)*",
+		"\"(\"[^)\\n]*\")\""
+	};
+
+	std::string ret = "%%\n\n";
+	std::set<std::string> words;
+	uint32_t seed = 2;
+	char buffer[64];
+
+	while (words.size() < scale) {
+		std::string w = Word(seed,2,6);
+		if (!words.insert(w).second) continue;
+
+		size_t n = words.size();
+		snprintf(buffer,sizeof(buffer),"\t{ return %zu; }\n",n);
+		ret += "\"" + w + "\"" + tails[n % 5] + buffer;
+	}
+
+	ret += "[ \\t\\n]\t{ }\n";
+	ret += ".\t\t{ return 0; }\n";
+	return ret;
+}
+
+/*	Nesting
+ *
+ *		A chain of N definitions, each defined in terms of the one before,
+ *	used by a handful of rules.
+ */
+
+static std::string Nesting(uint32_t scale)
+{
+	std::string ret = "D0\t[a-z]\n";
+	char buffer[64];
+
+	for (uint32_t i = 1; i <= scale; ++i) {
+		snprintf(buffer,sizeof(buffer),"D%u\t({D%u}[0-9]?)\n",i,i-1);
+		ret += buffer;
+	}
+
+	ret += "\n%%\n\n";
+	snprintf(buffer,sizeof(buffer),"{D%u}\t\t{ return 1; }\n",scale);
+	ret += buffer;
+	snprintf(buffer,sizeof(buffer),"{D%u}\"!\"\t{ return 2; }\n",scale / 2);
+	ret += buffer;
+	ret += "[ \\t\\n]\t{ }\n";
+	ret += ".\t\t{ return 0; }\n";
+	return ret;
+}
+
+/*	States
+ *
+ *		N start conditions, each with rules which move to the next. Start
+ *	conditions are stored as a 32-bit mask, so 32 is the most we can test.
+ */
+
+static std::string States(uint32_t scale)
+{
+	std::string ret;
+	char buffer[128];
+
+	for (uint32_t i = 0; i < scale; ++i) {
+		snprintf(buffer,sizeof(buffer),"%%start S%u\n",i);
+		ret += buffer;
+	}
+	ret += "\n%%\n\n";
+
+	uint32_t seed = 3;
+	for (uint32_t i = 0; i < scale; ++i) {
+		std::string w = Word(seed,2,6);
+		snprintf(buffer,sizeof(buffer),"<S%u>\"%s\"[a-z]*\t{ END S%u; BEGIN S%u; return %u; }\n",
+				i,w.c_str(),i,(i + 1) % scale,i + 1);
+		ret += buffer;
+		snprintf(buffer,sizeof(buffer),"<S%u>[0-9]+\t\t{ return %u; }\n",i,scale + i + 1);
+		ret += buffer;
+	}
+
+	ret += "\"begin\"\t{ BEGIN S0; return 0; }\n";
+	ret += "[ \\t\\n]\t{ }\n";
+	ret += ".\t\t{ return 0; }\n";
+	return ret;
+}
+
+static Family GFamilyList[] = {
+	{ "keywords", Keywords, { 100, 1000, 10000, 50000 } },
+	{ "regex", Regex, { 10, 100, 1000, 5000 } },
+	{ "nesting", Nesting, { 10, 50, 200, 1000 } },
+	{ "states", States, { 2, 8, 16, 32 } }
+};
+
+/************************************************************************/
+/*																		*/
+/*	Lexer Speed															*/
+/*																		*/
+/************************************************************************/
+
+/*	GDriver
+ *
+ *		Driver compiled with each lexer for -r. This reads the text into
+ *	memory, lexes it three times, and prints the best speed in MB/s.
+ */
+
+static const char *GDriver =
+	"#include <stdio.h>\n"                                                    \
+	"#include <stdlib.h>\n"                                                   \
+	"#include <string.h>\n"                                                   \
+	"#include <chrono>\n"                                                     \
+	"#include \"BenchLexer.h\"\n"                                             \
+	"\n"                                                                      \
+	"class BenchInput : public OCFileInput\n"                                 \
+	"{\n"                                                                     \
+	"\tpublic:\n"                                                             \
+	"\t\tBenchInput(const unsigned char *d, size_t l): data(d), len(l), pos(0) {}\n" \
+	"\t\tint readByte() { return (pos < len) ? data[pos++] : -1; }\n"         \
+	"\t\tint peekByte() { return (pos < len) ? data[pos] : -1; }\n"           \
+	"\t\tbool canRead() { return true; }\n"                                   \
+	"\n"                                                                      \
+	"\t\tsize_t read(unsigned char *buf, size_t max)\n"                       \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tif (max > len - pos) max = len - pos;\n"                         \
+	"\t\t\t\tmemcpy(buf, data + pos, max);\n"                                 \
+	"\t\t\t\tpos += max;\n"                                                   \
+	"\t\t\t\treturn max;\n"                                                   \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\tprivate:\n"                                                            \
+	"\t\tconst unsigned char *data;\n"                                        \
+	"\t\tsize_t len;\n"                                                       \
+	"\t\tsize_t pos;\n"                                                       \
+	"};\n"                                                                    \
+	"\n"                                                                      \
+	"int main(int argc, char *argv[])\n"                                      \
+	"{\n"                                                                     \
+	"\tFILE *f = fopen(argv[1], \"rb\");\n"                                   \
+	"\tif (f == NULL) return 1;\n"                                            \
+	"\tfseek(f, 0, SEEK_END);\n"                                              \
+	"\tsize_t len = (size_t)ftell(f);\n"                                      \
+	"\tfseek(f, 0, SEEK_SET);\n"                                              \
+	"\tunsigned char *data = (unsigned char *)malloc(len);\n"                 \
+	"\tif (fread(data, 1, len, f) != len) return 1;\n"                        \
+	"\tfclose(f);\n"                                                          \
+	"\n"                                                                      \
+	"\tdouble best = 0;\n"                                                    \
+	"\tfor (int i = 0; i < 3; ++i) {\n"                                       \
+	"\t\tBenchInput input(data, len);\n"                                      \
+	"\t\tBenchLexer lexer(&input);\n"                                         \
+	"\n"                                                                      \
+	"\t\tstd::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();\n" \
+	"\t\twhile (lexer.lex() != -1) ;\n"                                       \
+	"\t\tstd::chrono::duration<double> d = std::chrono::steady_clock::now() - start;\n" \
+	"\n"                                                                      \
+	"\t\tdouble speed = len / d.count() / 1e6;\n"                             \
+	"\t\tif (best < speed) best = speed;\n"                                   \
+	"\t}\n"                                                                   \
+	"\tprintf(\"%.3f\\n\", best);\n"                                          \
+	"\treturn 0;\n"                                                           \
+	"}\n";
+
+/*	Text
+ *
+ *		Text to lex, in the style of a source file: words, numbers, some
+ *	punctuation and white space. Words are drawn from the same sequence as
+ *	the keywords family, so those specs see keywords and identifiers. Every
+ *	family has a rule for any character, so any text can be lexed.
+ */
+
+static std::string Text(size_t size)
+{
+	static const char *punctuation[] = { "(", ")", ";", ",", "+", "=", "{", "}", "!" };
+	std::string ret;
+	uint32_t seed = 1;
+	uint32_t choice = 7;
+	size_t line = 0;
+
+	while (ret.size() < size) {
+		choice = choice * 1103515245 + 12345;
+		uint32_t n = (choice >> 16) % 16;
+
+		std::string token;
+		if (n < 10) {
+			token = Word(seed,2,10);
+		} else if (n < 13) {
+			token = std::to_string((choice >> 8) % 100000);
+		} else {
+			token = punctuation[(choice >> 4) % 9];
+		}
+
+		ret += token;
+		line += token.size() + 1;
+		if (line > 72) {
+			ret += "\n";
+			line = 0;
+		} else {
+			ret += " ";
+		}
+	}
+	return ret;
+}
+
+/*	WriteFile
+ *
+ *		Write a string to a file
+ */
+
+static bool WriteFile(const std::string &path, const std::string &data)
+{
+	FILE *f = fopen(path.c_str(),"w");
+	if (f == NULL) return false;
+	size_t len = fwrite(data.c_str(),1,data.size(),f);
+	fclose(f);
+	return len == data.size();
+}
+
+/*	LexSpeed
+ *
+ *		Write the lexer in the table format given to the directory, compile
+ *	it with the driver and run it over the text in the directory. Returns
+ *	the speed in MB/s, or a negative value if it could not be built or run.
+ */
+
+static double LexSpeed(OCLexCPPGenerator &generator, OCLexTableEnum format, const std::string &dir)
+{
+	generator.tableFormat = format;
+
+	std::string header = dir + "/BenchLexer.h";
+	std::string source = dir + "/BenchLexer.cpp";
+	std::string program = dir + "/bench";
+
+	FILE *f = fopen(header.c_str(),"w");
+	if (f == NULL) return -1;
+	generator.WriteOCHeader("BenchLexer","BenchLexer",f);
+	fclose(f);
+
+	f = fopen(source.c_str(),"w");
+	if (f == NULL) return -1;
+	generator.WriteOCFile("BenchLexer","BenchLexer",f);
+	fclose(f);
+
+	const char *cxx = getenv("CXX");
+	std::string cmd = std::string(cxx ? cxx : "c++") + " -O2 -w -o '" + program +
+			"' '" + source + "' '" + dir + "/BenchDriver.cpp'";
+	int status = system(cmd.c_str());
+	unlink(header.c_str());
+	unlink(source.c_str());
+	if (status != 0) return -1;
+
+	double speed = -1;
+	cmd = "'" + program + "' '" + dir + "/BenchText.txt'";
+	FILE *p = popen(cmd.c_str(),"r");
+	if (p != NULL) {
+		if (fscanf(p,"%lf",&speed) != 1) speed = -1;
+		if (pclose(p) != 0) speed = -1;
+	}
+	unlink(program.c_str());
+	return speed;
+}
+
+/*	RunLexers
+ *
+ *		For -r, time the lexer with comb tables and as code, and write the
+ *	speeds to the JSON object being written.
+ */
+
+static void RunLexers(OCLexCPPGenerator &generator)
+{
+	if (generator.dfaStates.size() > MAXRUNSTATES) {
+		printf(", \"lex_mb_s\": null");
+		return;
+	}
+
+	const char *tmp = getenv("TMPDIR");
+	char path[FILENAME_MAX];
+	snprintf(path,sizeof(path),"%s/oclexbench_XXXXXX",tmp ? tmp : "/tmp");
+	if (mkdtemp(path) == NULL) {
+		printf(", \"lex_mb_s\": null");
+		return;
+	}
+
+	std::string dir = path;
+	std::string driver = dir + "/BenchDriver.cpp";
+	std::string text = dir + "/BenchText.txt";
+
+	double comb = -1,code = -1;
+	if (WriteFile(driver,GDriver) && WriteFile(text,Text(RUNTEXTSIZE))) {
+		comb = LexSpeed(generator,KTableCompressed,dir);
+		code = LexSpeed(generator,KTableCode,dir);
+	}
+
+	unlink(driver.c_str());
+	unlink(text.c_str());
+	rmdir(path);
+
+	printf(", \"lex_mb_s\": {\"comb\": %.3f, \"code\": %.3f}",comb,code);
+}
+
+/************************************************************************/
+/*																		*/
+/*	Measurement															*/
+/*																		*/
+/************************************************************************/
+
+/*	Elapsed
+ *
+ *		Milliseconds since the time provided
+ */
+
+static double Elapsed(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double,std::milli> d = std::chrono::steady_clock::now() - start;
+	return d.count();
+}
+
+/*	PeakMemory
+ *
+ *		Peak resident set size of this process, in bytes
+ */
+
+static uint64_t PeakMemory()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF,&usage);
+
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss;			// bytes on macOS
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;	// kilobytes elsewhere
+#endif
+}
+
+/*	FileSize
+ *
+ *		Size of a file we've written
+ */
+
+static long FileSize(FILE *f)
+{
+	fflush(f);
+	return ftell(f);
+}
+
+/*	Run
+ *
+ *		Generate a lexer for the spec, and write the timings for each phase
+ *	as a JSON object. This runs in its own process, so the peak memory is
+ *	for this spec alone.
+ */
+
+static int Run(const char *family, uint32_t scale, const std::string &spec)
+{
+	char path[FILENAME_MAX];
+	bool keep = (GDirectory != NULL);
+	if (keep) {
+		snprintf(path,sizeof(path),"%s/%s_%u.l",GDirectory,family,scale);
+	} else {
+		const char *tmp = getenv("TMPDIR");
+		snprintf(path,sizeof(path),"%s/oclexbench_%d.l",tmp ? tmp : "/tmp",(int)getpid());
+	}
+
+	FILE *f = fopen(path,"w");
+	if (f == NULL) {
+		fprintf(stderr,"Unable to write to file %s\n",path);
+		return -1;
+	}
+	fwrite(spec.c_str(),1,spec.size(),f);
+	fclose(f);
+
+	/*
+	 *	Parse
+	 */
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	OCLexer lexer;
+	lexer.OpenFile(path);
+	OCLexParser parser;
+	bool parsed = parser.ParseFile(lexer);
+
+	double parseTime = Elapsed(start);
+	if (!keep) unlink(path);
+	if (!parsed) {
+		fprintf(stderr,"Unable to parse the %s spec at scale %u\n",family,scale);
+		return -1;
+	}
+
+	/*
+	 *	Build the NFA
+	 */
+
+	start = std::chrono::steady_clock::now();
+
+	OCLexCPPGenerator generator(parser.definitions);
+	generator.declCode = parser.declCode;
+	generator.classGlobal = parser.classGlobal;
+	generator.classLocal = parser.classLocal;
+	generator.classInit = parser.classInit;
+	generator.classFinish = parser.classFinish;
+	generator.classHeader = parser.classHeader;
+	generator.valueUnion = parser.valueUnion;
+	generator.endCode = parser.endCode;
+	generator.ruleStates = parser.ruleStates;
+	generator.threads = GThreads;
+
+	std::list<OCLexParser::Rule>::iterator i;
+	for (i = parser.rules.begin(); i != parser.rules.end(); ++i) {
+		generator.AddRuleSet(i->regex, i->code, i->start);
+	}
+
+	double nfaTime = Elapsed(start);
+
+	/*
+	 *	Build the DFA
+	 */
+
+	start = std::chrono::steady_clock::now();
+	if (!generator.GenerateDFA()) {
+		fprintf(stderr,"Unable to build the DFA for the %s spec at scale %u\n",family,scale);
+		return -1;
+	}
+	double dfaTime = Elapsed(start);
+
+	// Literal strings are added to the NFA as the DFA is built
+	uint32_t nfaStates = generator.StateCount();
+
+	/*
+	 *	Write the tables. We write to temporary files, to measure the size
+	 */
+
+	start = std::chrono::steady_clock::now();
+
+	FILE *header = tmpfile();
+	FILE *source = tmpfile();
+	if ((header == NULL) || (source == NULL)) {
+		fprintf(stderr,"Unable to create temporary files\n");
+		return -1;
+	}
+	generator.WriteOCHeader("BenchLexer","BenchLexer",header);
+	generator.WriteOCFile("BenchLexer","BenchLexer",source);
+	long outputBytes = FileSize(header) + FileSize(source);
+
+	double emitTime = Elapsed(start);
+
+	fclose(header);
+	fclose(source);
+
+	/*
+	 *	Report
+	 */
+
+	printf("  {\"family\": \"%s\", \"scale\": %u, \"rules\": %zu, "
+		   "\"parse_ms\": %.3f, \"nfa_ms\": %.3f, \"dfa_ms\": %.3f, \"emit_ms\": %.3f, "
+		   "\"nfa_states\": %u, \"dfa_states\": %zu, \"char_classes\": %zu, "
+		   "\"table_bytes\": %zu, \"output_bytes\": %ld, \"peak_rss_bytes\": %llu",
+		   family,scale,parser.rules.size(),
+		   parseTime,nfaTime,dfaTime,emitTime,
+		   nfaStates,generator.dfaStates.size(),generator.charClasses.size(),
+		   generator.tableBytes,outputBytes,(unsigned long long)PeakMemory());
+	if (GRunLexers) {
+		fflush(stdout);
+		RunLexers(generator);
+	}
+	printf("}");
+	fflush(stdout);
+	return 0;
+}
+
+/************************************************************************/
+/*																		*/
+/*	Startup																*/
+/*																		*/
+/************************************************************************/
+
+/*	ParseArgs
+ *
+ *		Parse the input arguments
+ *
+ *		-h			Help
+ *		-j threads	Number of threads used to build the DFA
+ *		-f family	Run only this family of specs
+ *		-o dir		Write the specs to this directory
+ *		-r			Compile and time the lexers
+ */
+
+static void ParseArgs(int argc, const char *argv[])
+{
+	for (int i = 1; i < argc; ) {
+		const char *ptr = argv[i++];
+		if (!strcmp(ptr,"-j") && (i < argc)) {
+			long n;
+			if (!OCParseNumber(argv[i++],1,INT_MAX,n)) {
+				printf("%s\n",GHelp);
+				exit(1);
+			}
+			GThreads = (uint32_t)n;
+		} else if (!strcmp(ptr,"-f") && (i < argc)) {
+			GFamilies.insert(argv[i++]);
+		} else if (!strcmp(ptr,"-o") && (i < argc)) {
+			GDirectory = argv[i++];
+		} else if (!strcmp(ptr,"-r")) {
+			GRunLexers = true;
+		} else {
+			printf("%s\n",GHelp);
+			exit(strcmp(ptr,"-h") ? 1 : 0);
+		}
+	}
+}
+
+/*	main
+ *
+ *		Run each spec at each scale in a child process. The results are
+ *	written as a JSON array, one object per spec.
+ */
+
+int main(int argc, const char * argv[])
+{
+	ParseArgs(argc,argv);
+
+	bool first = true;
+	int ret = 0;
+
+	printf("[\n");
+	size_t i,len = sizeof(GFamilyList)/sizeof(GFamilyList[0]);
+	for (i = 0; i < len; ++i) {
+		const Family &family = GFamilyList[i];
+		if (!GFamilies.empty() && !GFamilies.count(family.name)) continue;
+
+		for (int j = 0; j < 4; ++j) {
+			uint32_t scale = family.scales[j];
+			std::string spec = family.build(scale);
+
+			if (!first) printf(",\n");
+			first = false;
+			fflush(stdout);
+
+			pid_t pid = fork();
+			if (pid == 0) {
+				_exit(Run(family.name,scale,spec) ? 1 : 0);
+			}
+
+			int status = 0;
+			if ((pid < 0) || (waitpid(pid,&status,0) < 0) ||
+					!WIFEXITED(status) || WEXITSTATUS(status)) {
+				fprintf(stderr,"%s at scale %u failed\n",family.name,scale);
+				printf("  {\"family\": \"%s\", \"scale\": %u, \"error\": true}",family.name,scale);
+				ret = 1;
+			}
+		}
+	}
+	printf("\n]\n");
+
+	return ret;
+}
@@ -0,0 +1,39 @@
+#	DiffCompare.cmake
+#
+#		Runs the lexer built with the option under test (TEST) over each file
+#	in INPUT_DIR, reading in each way the lexer can, and fails if its output
+#	differs from the file of the same name in EXPECTED_DIR, with .out added.
+#	The expected output was written by a lexer built with the original oclex.
+#
+#		cmake -DTEST=... -DINPUT_DIR=... -DEXPECTED_DIR=... -P DiffCompare.cmake
+
+file(GLOB inputs ${INPUT_DIR}/*)
+list(SORT inputs)
+
+set(failed 0)
+foreach(input ${inputs})
+	get_filename_component(name ${input} NAME)
+	set(expectedFile ${EXPECTED_DIR}/${name}.out)
+	if(NOT EXISTS ${expectedFile})
+		message(SEND_ERROR "No expected output ${expectedFile}")
+		set(failed 1)
+		continue()
+	endif()
+	file(READ ${expectedFile} expected)
+
+	foreach(mode bytes blocks memory)
+		execute_process(COMMAND ${TEST} ${mode} ${input}
+				OUTPUT_VARIABLE actual RESULT_VARIABLE testResult)
+		if(NOT testResult EQUAL 0)
+			message(SEND_ERROR "${TEST} ${mode} ${input} failed: ${testResult}")
+			set(failed 1)
+		elseif(NOT expected STREQUAL actual)
+			message(SEND_ERROR "${TEST} ${mode} ${input} differs from ${expectedFile}")
+			set(failed 1)
+		endif()
+	endforeach()
+endforeach()
+
+if(failed)
+	message(FATAL_ERROR "Output differs from the expected tokens")
+endif()
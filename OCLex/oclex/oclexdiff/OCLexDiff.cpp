@@ -0,0 +1,128 @@
+//
+//  OCLexDiff.cpp
+//  oclexdiff
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "DiffLex.h"
+
+/*	oclexdiff
+ *
+ *		Lexes a file with DiffLex and prints each token with its line,
+ *	column and text. The differential test builds DiffLex once for each
+ *	oclex option, and checks that each prints the tokens in expected/.
+ *
+ *		The position is found through tokenOffset() and position(), and the
+ *	text through textData() and textLength(), so the same code runs with
+ *	and without -d and -n.
+ */
+
+/*	FileInput
+ *
+ *		Reads the file a byte at a time, or in blocks if blocks is set.
+ */
+
+class FileInput : public OCFileInput
+{
+	public:
+		FileInput(FILE *f, bool b) : file(f), blocks(b)
+			{
+			}
+
+		int readByte()
+			{
+				return fgetc(file);
+			}
+
+		int peekByte()
+			{
+				int ch = fgetc(file);
+				if (ch != EOF) ungetc(ch,file);
+				return ch;
+			}
+
+		bool canRead()
+			{
+				return blocks;
+			}
+
+		size_t read(unsigned char *buf, size_t max)
+			{
+				return fread(buf,1,max,file);
+			}
+
+	private:
+		FILE *file;
+		bool blocks;
+};
+
+/*	PrintTokens
+ *
+ *		Print each token until the end of the file or an error
+ */
+
+static void PrintTokens(DiffLex &lex)
+{
+	int32_t token;
+	while (-1 != (token = lex.lex())) {
+		int32_t line, column;
+		lex.position(lex.tokenOffset(),line,column);
+		printf("%d:%d %d '",line,column,token);
+
+		const char *text = lex.textData();
+		size_t len = lex.textLength();
+		for (size_t i = 0; i < len; ++i) {
+			if (text[i] == '\n') {
+				printf("\\n");
+			} else {
+				putchar(text[i]);
+			}
+		}
+		printf("'\n");
+	}
+	printf("end '%s'\n",lex.abort.c_str());
+}
+
+/*	main
+ *
+ *		oclexdiff [bytes|blocks|memory] inputfile
+ */
+
+int main(int argc, const char *argv[])
+{
+	if (argc != 3) {
+		fprintf(stderr,"Usage: oclexdiff [bytes|blocks|memory] inputfile\n");
+		return 1;
+	}
+
+	FILE *f = fopen(argv[2],"rb");
+	if (f == NULL) {
+		fprintf(stderr,"Unable to read %s\n",argv[2]);
+		return 1;
+	}
+
+	if (!strcmp(argv[1],"memory")) {
+		std::string data;
+		char buffer[4096];
+		size_t len;
+		while (0 != (len = fread(buffer,1,sizeof(buffer),f))) {
+			data.append(buffer,len);
+		}
+		DiffLex lex(data.data(),data.size());
+		PrintTokens(lex);
+	} else {
+		FileInput input(f,!strcmp(argv[1],"blocks"));
+		DiffLex lex(&input);
+		PrintTokens(lex);
+	}
+
+	fclose(f);
+	return 0;
+}
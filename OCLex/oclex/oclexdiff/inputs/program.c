@@ -0,0 +1,53 @@
+#include <stdio.h>
+#import "local.h"
+
+/*	A small C program, so the lexer sees the usual mix of keywords,
+ *	identifiers, numbers, strings and comments.
+ */
+
+typedef struct Point {
+	double x, y;
+	unsigned long tag;
+} Point;
+
+static const char *names[] = { "zero", "one", "two\n", "\"quoted\"", 0 };
+
+enum Shape { CIRCLE = 0x10, SQUARE = 0X2aUL, TRIANGLE = 077 };
+
+// Return the sum of the first n values
+extern int sum(int *values, register int n)
+{
+	int total = 0;
+	for (int i = 0; i < n; ++i) total += values[i];
+	return total;
+}
+
+float scale(float f)
+{
+	f *= 1.5e3f;
+	f -= .25;
+	f += 3.;
+	f /= 2E-2L;
+	return f;
+}
+
+int main(int argc, char **argv)
+{
+	Point p = { 1.0, 2.0, 3u };
+	volatile signed short s = sizeof(p);
+	char c = '\'', d = '\\', e = 'x';
+	long bits = 1L << 4;
+	bits >>= 1; bits <<= 2;
+	if (argc > 1) goto done; else do { s--; } while (s > 0);
+	switch (c) {
+		case 'a': break;
+		default: continue;
+	}
+	int (*fn)(int *, int) = sum;
+	p.x = p.y->z;
+	printf("%d %s...\n", fn(0, 0), names[1]);
+	/* one line comment */ /* two
+	   line comment */
+done:
+	return 0;
+}
@@ -0,0 +1,216 @@
+//
+//  OCSetTest.cpp
+//  ocsettest
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <stdio.h>
+
+#include <set>
+
+#include "OCUtilities.h"
+
+/*	ocsettest
+ *
+ *		Checks OCIntegerSet and OCIntegerSetMap directly. A set is kept as a
+ *	sorted list while it is small or sparse, and as a bitset once it is
+ *	dense, so each check builds its sets so that they take both forms, or
+ *	the same form with different ranges of bits.
+ */
+
+static int GFailed = 0;
+
+#define CHECK(x)	Check((x),#x,__LINE__)
+
+static void Check(bool test, const char *text, int line)
+{
+	if (!test) {
+		printf("Line %d: failed %s\n",line,text);
+		++GFailed;
+	}
+}
+
+/*	Matches
+ *
+ *		True if the set holds exactly the items in ref, in ascending order
+ */
+
+static bool Matches(const OCIntegerSet &set, const std::set<uint32_t> &ref)
+{
+	if (set.Size() != ref.size()) return false;
+
+	OCIntegerSet::Iterator iter(set);
+	std::set<uint32_t>::const_iterator r = ref.begin();
+	uint32_t val;
+	while (iter.Next(val)) {
+		if ((r == ref.end()) || (*r != val)) return false;
+		if (!set.Contains(val)) return false;
+		++r;
+	}
+	return r == ref.end();
+}
+
+/*	TestSwitch
+ *
+ *		Grow a set one item at a time past the point where it becomes a
+ *	bitset, then remove items from it, checking it against std::set.
+ */
+
+static void TestSwitch()
+{
+	OCIntegerSet set;
+	std::set<uint32_t> ref;
+
+	for (uint32_t i = 0; i < 200; ++i) {
+		uint32_t val = 1000 + i * 3;
+		set.Add(val);
+		ref.insert(val);
+		CHECK(Matches(set,ref));
+	}
+
+	// Items beyond either end of the bitset
+	set.Add(5);
+	ref.insert(5);
+	set.Add(5000);
+	ref.insert(5000);
+	CHECK(Matches(set,ref));
+
+	for (uint32_t i = 0; i < 200; i += 2) {
+		uint32_t val = 1000 + i * 3;
+		set.Remove(val);
+		ref.erase(val);
+		CHECK(!set.Contains(val));
+		CHECK(Matches(set,ref));
+	}
+
+	// Removing an item which is not there changes nothing
+	set.Remove(1001);
+	set.Remove(7);
+	CHECK(Matches(set,ref));
+
+	set.RemoveAll();
+	CHECK(set.Size() == 0);
+	CHECK(!set.Contains(5));
+}
+
+/*	TestEqual
+ *
+ *		Compare sets with the same and with different items, each as a list
+ *	and as a bitset.
+ */
+
+static void TestEqual()
+{
+	static const uint32_t items[] = { 64, 70, 100, 127 };
+
+	// A bitset from 0, with everything below 64 removed
+	OCIntegerSet dense;
+	for (uint32_t i = 0; i < 128; ++i) dense.Add(i);
+	for (uint32_t i = 0; i < 128; ++i) {
+		if ((i != 64) && (i != 70) && (i != 100) && (i != 127)) dense.Remove(i);
+	}
+
+	// A bitset starting at 64 with the same items
+	OCIntegerSet dense64;
+	for (uint32_t i = 64; i < 128; ++i) dense64.Add(i);
+	for (uint32_t i = 64; i < 128; ++i) {
+		if ((i != 64) && (i != 70) && (i != 100) && (i != 127)) dense64.Remove(i);
+	}
+
+	// And a list
+	OCIntegerSet sorted;
+	sorted.Assign(items,4);
+
+	CHECK(dense == sorted);
+	CHECK(sorted == dense);
+	CHECK(dense == dense64);
+	CHECK(dense64 == sorted);
+	CHECK(dense.Hash() == sorted.Hash());
+	CHECK(dense64.Hash() == sorted.Hash());
+
+	// Same size, differing only in the last item
+	static const uint32_t other[] = { 64, 70, 100, 126 };
+	OCIntegerSet sorted2;
+	sorted2.Assign(other,4);
+	CHECK(!(dense == sorted2));
+	CHECK(!(sorted2 == dense));
+	CHECK(!(sorted == sorted2));
+
+	// The cached hash follows the set as it changes
+	uint64_t hash = sorted.Hash();
+	sorted.Remove(127);
+	sorted.Add(126);
+	CHECK(sorted == sorted2);
+	CHECK(sorted.Hash() == sorted2.Hash());
+	CHECK(sorted.Hash() != hash);
+
+	dense.Remove(127);
+	CHECK(!(dense == dense64));
+	CHECK(dense.Hash() != dense64.Hash());
+	dense.Add(126);
+	CHECK(dense == sorted2);
+	CHECK(dense.Hash() == sorted2.Hash());
+
+	OCIntegerSet empty1,empty2;
+	CHECK(empty1 == empty2);
+	CHECK(empty1.Hash() == empty2.Hash());
+	CHECK(!(empty1 == sorted));
+}
+
+/*	TestMap
+ *
+ *		Intern enough sets to grow the map, then find each again from a
+ *	copy built the other way.
+ */
+
+static void TestMap()
+{
+	OCIntegerSetMap map;
+	bool added;
+	uint32_t index;
+
+	for (uint32_t n = 0; n < 1000; ++n) {
+		OCIntegerSet set;
+		for (uint32_t i = 0; i < 40; ++i) set.Add(n + i);
+		CHECK(map.Intern(set,added) == n);
+		CHECK(added);
+	}
+	CHECK(map.Size() == 1000);
+
+	for (uint32_t n = 0; n < 1000; ++n) {
+		uint32_t list[40];
+		for (uint32_t i = 0; i < 40; ++i) list[i] = n + 39 - i;
+
+		OCIntegerSet set;
+		for (uint32_t i = 0; i < 40; ++i) set.Add(list[i]);
+		CHECK(map.Find(set,index) && (index == n));
+		CHECK(map.Intern(set,added) == n);
+		CHECK(!added);
+		CHECK(map.Item(n) == set);
+	}
+
+	OCIntegerSet missing;
+	missing.Add(3);
+	CHECK(!map.Find(missing,index));
+	CHECK(map.Intern(missing,added) == 1000);
+	CHECK(added);
+
+	map.Clear();
+	CHECK(map.Size() == 0);
+	CHECK(!map.Find(missing,index));
+}
+
+int main(void)
+{
+	TestSwitch();
+	TestEqual();
+	TestMap();
+
+	if (GFailed) {
+		printf("%d checks failed\n",GFailed);
+		return 1;
+	}
+	return 0;
+}
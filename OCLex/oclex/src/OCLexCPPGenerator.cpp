@@ -8,6 +8,10 @@
 
 #include "OCLexCPPGenerator.h"
 
+#include <string.h>
+#include <map>
+#include <set>
+
 /************************************************************************/
 /*																		*/
 /*	Standard Header														*/
@@ -29,15 +33,19 @@ static const char *GHeader1 =
 	"\n"                                                                      \
 	"#include <stdint.h>\n"                                                   \
 	"#include <string>\n"                                                     \
+	"#if __cplusplus >= 201703L\n"                                            \
+	"#include <string_view>\n"                                                \
+	"#endif\n"                                                                \
 	"\n";
 
-// 6
+// 9
 static const char *GHeader2 =
 	"/*\tOCFileInput\n"                                                       \
 	" *\n"                                                                    \
 	" *\t\tThe input file stream must correspond to this interface to read\n" \
 	" *\tthe contents of a file or data object. The byte returned is from 0 to 255,\n" \
-	" *\tand EOF is marked with -1.\n"                                        \
+	" *\tand EOF is marked with -1. Streams which can read more than a byte at a\n" \
+	" *\ttime should also override canRead and read.\n"                       \
 	" */\n"                                                                   \
 	"\n"                                                                      \
 	"#ifndef OCFileInputProtocolC\n"                                          \
@@ -48,6 +56,79 @@ static const char *GHeader2 =
 	"\tpublic:\n"                                                             \
 	"\t\tvirtual int readByte() = 0;\n"                                       \
 	"\t\tvirtual int peekByte() = 0;\n"                                       \
+	"\n"                                                                      \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tIf canRead returns true, the lexer reads with read instead,\n"   \
+	"\t\t *\twhich reads up to max bytes into buf, returning the number read,\n" \
+	"\t\t *\tor 0 at EOF. It should not wait for more than is available.\n"   \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual bool canRead()\n"                                            \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn false;\n"                                                 \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual size_t read(unsigned char *buf, size_t max)\n"               \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tint ch = readByte();\n"                                          \
+	"\t\t\t\tif ((ch == -1) || (max == 0)) return 0;\n"                       \
+	"\t\t\t\tbuf[0] = (unsigned char)ch;\n"                                   \
+	"\t\t\t\treturn 1;\n"                                                     \
+	"\t\t\t}\n"                                                               \
+	"};\n"                                                                    \
+	"\n"                                                                      \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"/*\tOCMappedFile\n"                                                      \
+	" *\n"                                                                    \
+	" *\t\tMaps a file into memory, to pass to the lexer\'s in memory constructor.\n" \
+	" *\tdata is NULL if the file could not be mapped. The mapping lasts as long\n" \
+	" *\tas this object does. Define OCLexMappedFile before including this\n" \
+	" *\theader to use it; it needs the POSIX headers for mmap.\n"           \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"#if defined(OCLexMappedFile) && !defined(_WIN32) && !defined(OCMappedFileC)\n" \
+	"#define OCMappedFileC\n"                                                 \
+	"\n"                                                                      \
+	"#include <fcntl.h>\n"                                                    \
+	"#include <sys/mman.h>\n"                                                 \
+	"#include <sys/stat.h>\n"                                                 \
+	"#include <unistd.h>\n"                                                   \
+	"\n"                                                                      \
+	"class OCMappedFile\n"                                                    \
+	"{\n"                                                                     \
+	"\tpublic:\n"                                                             \
+	"\t\tOCMappedFile(const char *path)\n"                                    \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tdata = NULL;\n"                                                  \
+	"\t\t\t\tsize = 0;\n"                                                     \
+	"\n"                                                                      \
+	"\t\t\t\tint fd = open(path, O_RDONLY);\n"                                \
+	"\t\t\t\tif (fd < 0) return;\n"                                           \
+	"\n"                                                                      \
+	"\t\t\t\tstruct stat st;\n"                                               \
+	"\t\t\t\tif ((fstat(fd, &st) == 0) && (st.st_size > 0)) {\n"              \
+	"\t\t\t\t\tvoid *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);\n" \
+	"\t\t\t\t\tif (ptr != MAP_FAILED) {\n"                                    \
+	"\t\t\t\t\t\tmadvise(ptr, (size_t)st.st_size, MADV_SEQUENTIAL);\n"        \
+	"\t\t\t\t\t\tdata = (const char *)ptr;\n"                                 \
+	"\t\t\t\t\t\tsize = (size_t)st.st_size;\n"                                \
+	"\t\t\t\t\t}\n"                                                           \
+	"\t\t\t\t}\n"                                                             \
+	"\t\t\t\tclose(fd);\n"                                                    \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\t~OCMappedFile()\n"                                                   \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tif (data) munmap((void *)data, size);\n"                         \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tconst char *data;\n"                                                 \
+	"\t\tsize_t size;\n"                                                      \
+	"\n"                                                                      \
+	"\tprivate:\n"                                                            \
+	"\t\tOCMappedFile(const OCMappedFile &);\n"                               \
+	"\t\tOCMappedFile &operator = (const OCMappedFile &);\n"                  \
 	"};\n"                                                                    \
 	"\n"                                                                      \
 	"#endif\n"                                                                \
@@ -61,6 +142,7 @@ static const char *GHeader2 =
 	"{\n"                                                                     \
 	"\tpublic:\n"                                                             \
 	"\t\t%s(OCFileInput *file);\n"                                            \
+	"\t\t%s(const char *data, size_t len);\n"                                 \
 	"\t\t~%s(void);\n"                                                        \
 	"\n"                                                                      \
 	"\t\t/*\n"                                                                \
@@ -70,8 +152,7 @@ static const char *GHeader2 =
 	"\t\tint32_t line;\n"                                                     \
 	"\t\tint32_t column;\n"                                                   \
 	"\t\tstd::string filename;\n"                                             \
-	"\t\tstd::string text;\n"                                                 \
-	"\t\tstd::string abort;\n"                                                \
+	"%s\t\tstd::string abort;\n"                                              \
 	"\n"                                                                      \
 	"#ifdef %s_ValueDefined\n"                                                \
 	"\t\tunion %sValue value;\n"                                              \
@@ -79,51 +160,170 @@ static const char *GHeader2 =
 	"\n"                                                                      \
 	"\t\tvoid setFile(std::string &file, int32_t line);\n"                    \
 	"\t\tvoid setLine(int32_t line);\n"                                       \
-	"\t\tint32_t lex();\t\t\t\t\t\t// Method to read next token\n";
-
-// 0
-static const char *GHeader3 =
-	"\tprivate:\n"                                                            \
-	"\t\t// Files\n"                                                          \
-	"\t\tOCFileInput *file;\n"                                                \
+	"\t\tint32_t lex();\t\t\t\t\t\t// Method to read next token\n"            \
 	"\n"                                                                      \
-	"\t\t// Read position support\n"                                          \
-	"\t\tint32_t curLine;\n"                                                  \
-	"\t\tint32_t curColumn;\n"                                                \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tThe text of the token just read, read in place rather than\n"    \
+	"\t\t *\tcopied into text. This is valid until the next call to lex().\n" \
+	"\t\t */\n"                                                               \
 	"\n"                                                                      \
-	"\t\t// Mark location support\n"                                          \
-	"\t\tint32_t markLine;\n"                                                 \
-	"\t\tint32_t markColumn;\n"                                               \
+	"\t\tconst char *textData(void) const\n"                                  \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn (const char *)buffer + tokenStart;\n"                     \
+	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
-	"\t\t// Mark buffer storage\n"                                            \
-	"\t\tbool isMarked;\t\t\t\t\t\t// yes if we have mark set\n"              \
-	"\t\tunsigned char *markBuffer;\t\t\t// mark buffer\n"                    \
-	"\t\tint32_t markSize;\t\t\t\t\t// bytes stored in buffer\n"              \
-	"\t\tint32_t markAlloc;\t\t\t\t\t// capacity of buffer\n"                 \
+	"\t\tsize_t textLength(void) const\n"                                     \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn (size_t)(cursor - tokenStart);\n"                         \
+	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
-	"\t\t// Read cache\n"                                                     \
-	"\t\tunsigned char *readBuffer;\t\t\t// read cache buffer\n"              \
-	"\t\tint32_t readPos;\t\t\t\t\t// Read position\n"                        \
-	"\t\tint32_t readSize;\t\t\t\t\t// size of data in read buffer\n"         \
-	"\t\tint32_t readAlloc;\t\t\t\t\t// Capacity of read cache\n"             \
+	"#if __cplusplus >= 201703L\n"                                            \
+	"\t\tstd::string_view textView(void) const\n"                             \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn std::string_view(textData(),textLength());\n"             \
+	"\t\t\t}\n"                                                               \
+	"#endif\n"                                                                \
+	"%s";
+
+// 2
+static const char *GHeader3 =
+	"\tprivate:\n"                                                            \
+	"\t\t// Files; NULL if reading from memory\n"                             \
+	"\t\tOCFileInput *file;\n"                                                \
 	"\n"                                                                      \
-	"\t\t// Text read buffer\n"                                               \
-	"\t\tunsigned char *textBuffer;\t\t\t// text cache for reading buffer\n"  \
-	"\t\tint32_t textMarkSize;\n"                                             \
-	"\t\tint32_t textSize;\n"                                                 \
-	"\t\tint32_t textAlloc;\n"                                                \
+	"%s\t\t// Input window. The token being read runs from tokenStart to cursor,\n" \
+	"\t\t// and markPos is where the last rule it matched ended. Reading from\n" \
+	"\t\t// memory, the window is the data itself.\n"                         \
+	"\t\tbool bulk;\t\t\t\t\t\t\t// read with file->read, or from memory\n"   \
+	"\t\tunsigned char *buffer;\t\t\t\t// input window\n"                     \
+	"\t\tint32_t bufferSize;\t\t\t\t\t// size of data in window\n"            \
+	"\t\tint32_t bufferAlloc;\t\t\t\t// capacity of window; 0 in memory\n"    \
+	"\t\tint32_t tokenStart;\t\t\t\t\t// start of the token\n"                \
+	"\t\tint32_t cursor;\t\t\t\t\t\t// next character to read\n"              \
+	"\t\tint32_t markPos;\t\t\t\t\t// end of the token at the mark\n"         \
 	"\n"                                                                      \
 	"\t\t// State flags\n"                                                    \
 	"\t\tuint64_t  states;\n"                                                 \
 	"\n"                                                                      \
+	"\t\t// Shared constructor\n"                                             \
+	"\t\t%s(OCFileInput *f, const char *data, size_t len);\n"                 \
+	"\n"                                                                      \
 	"\t\t// Internal Methods\n"                                               \
 	"\t\tvoid mark(void);\n"                                                  \
 	"\t\tvoid reset(void);\n"                                                 \
 	"\t\tint input(void);\n"                                                  \
+	"\t\tbool fill(void);\n"                                                  \
 	"\t\tbool atEOL(void);\n"                                                 \
 	"\t\tbool atSOL(void);\n"                                                 \
-	"\t\tuint16_t stateForClass(uint16_t charClass, uint16_t state);\n"       \
-	"\t\tuint16_t conditionalAction(uint16_t state);\n";
+	"\t\tuint32_t stateForClass(uint32_t charClass, uint32_t state);\n"       \
+	"\t\tuint32_t conditionalAction(uint32_t state);\n";
+
+// 0
+static const char *GLazyHeader =
+	"\t\t// Lazy DFA cache\n"                                                 \
+	"\t\tint32_t *lazyNext;\t\t\t\t\t// transitions, -1 if not known\n"       \
+	"\t\tuint32_t *lazyRule;\t\t\t\t\t// action for each state\n"             \
+	"\t\tuint32_t *lazySetStart;\t\t\t\t// NFA states for each state\n"       \
+	"\t\tuint32_t *lazySets;\n"                                               \
+	"\t\tint32_t *lazyHash;\t\t\t\t\t// maps NFA states to state\n"           \
+	"\t\tuint32_t *lazyMark;\t\t\t\t\t// scratch space\n"                     \
+	"\t\tuint32_t *lazyWork;\n"                                               \
+	"\t\tuint32_t lazyStamp;\n"                                               \
+	"\t\tuint32_t lazyCount;\t\t\t\t\t// states in the cache\n"               \
+	"\t\tuint32_t lazyFlushes;\t\t\t\t// times the cache was emptied\n"       \
+	"\n"                                                                      \
+	"\t\tvoid lazyInit(void);\n"                                              \
+	"\t\tvoid lazyFree(void);\n"                                              \
+	"\t\tvoid lazyFlush(void);\n"                                             \
+	"\t\tuint32_t lazyState(const uint32_t *set, uint32_t size);\n"           \
+	"\t\tuint32_t lazyAction(uint32_t state);\n"                              \
+	"\t\tbool lazyRuleMatches(uint32_t rule);\n";
+
+// 0
+static const char *GTextField =
+	"\t\tstd::string text;\n";
+
+// 2
+static const char *GPairHeader =
+	"\t\tvoid unput(%s);\n"                                                   \
+	"\t\tvoid markPair(%s);\n";
+
+// 0
+static const char *GLoopHeader =
+	"\t\tvoid loop(uint32_t state);\n";
+
+/*
+ *	Read positions. The GLines templates keep the line and column as the
+ *	lexer reads; the GOffset templates only keep file offsets, and find the
+ *	line and column of an offset when asked. See trackLines.
+ */
+
+// 0
+static const char *GLinesPublic =
+	"\n"                                                                      \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tPositions. This lexer keeps line and column as it reads, so\n"   \
+	"\t\t *\ttokens have no offset, and position returns line and column.\n"  \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tint64_t tokenOffset(void) const\n"                                   \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn -1;\n"                                                    \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvoid position(int64_t, int32_t &atLine, int32_t &atColumn)\n"        \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tatLine = line;\n"                                                \
+	"\t\t\t\tatColumn = column;\n"                                            \
+	"\t\t\t}\n";
+
+// 0
+static const char *GOffsetPublic =
+	"\n"                                                                      \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tPositions. This lexer does not set line and column as it reads;\n" \
+	"\t\t *\tit keeps the offset of each token in the file, and position finds\n" \
+	"\t\t *\tthe line and column of an offset read so far when asked.\n"      \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tint64_t tokenOffset(void) const\n"                                   \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn bufferOffset + tokenStart;\n"                             \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvoid position(int64_t offset, int32_t &atLine, int32_t &atColumn);\n";
+
+// 0
+static const char *GLinesFields =
+	"\t\t// Read position support\n"                                          \
+	"\t\tint32_t curLine;\n"                                                  \
+	"\t\tint32_t curColumn;\n"                                                \
+	"\n"                                                                      \
+	"\t\t// Mark location support\n"                                          \
+	"\t\tint32_t markLine;\n"                                                 \
+	"\t\tint32_t markColumn;\n"                                               \
+	"\n";
+
+// 0
+static const char *GOffsetFields =
+	"\t\t// Read position support. We keep the file offset of the window, and\n" \
+	"\t\t// index the newlines before an offset when asked for its position,\n" \
+	"\t\t// or before the window slides past them. The index holds the low 16\n" \
+	"\t\t// bits of each newline\'s offset, and the number of newlines before\n" \
+	"\t\t// each 64K chunk. lineSet holds where setLine was called, and the\n" \
+	"\t\t// line there less the newlines before it.\n"                        \
+	"\t\tint64_t bufferOffset;\t\t\t\t// file offset of buffer[0]\n"          \
+	"\t\tint64_t indexed;\t\t\t\t\t// newlines indexed up to here\n"          \
+	"\t\tstd::vector<uint32_t> lineChunk;\t// newlines before each chunk\n"   \
+	"\t\tstd::vector<uint16_t> lineEnds;\t\t// newline offsets in chunk\n"    \
+	"\t\tstd::vector<std::pair<int64_t,int32_t> > lineSet;\n"                 \
+	"\n";
+
+// 0
+static const char *GOffsetHeader =
+	"\t\tvoid indexLines(int64_t end);\n"                                     \
+	"\t\tvoid addLine(int64_t offset);\n"                                     \
+	"\t\tsize_t countLines(int64_t offset, int64_t &start);\n";
 
 // 0
 static const char *GHeader4 =
@@ -139,7 +339,7 @@ static const char *GHeader4 =
 
 // 2
 static const char *GSource1 =
-	"/*\t%s.cpp\n"                                                              \
+	"/*\t%s.cpp\n"                                                            \
 	" *\n"                                                                    \
 	" *\t\tThis file was automatically generated by OCLex, part of the OCTools\n" \
 	" *\tsuite available at:\n"                                               \
@@ -152,9 +352,37 @@ static const char *GSource1 =
 	"#include <string.h>\n"                                                   \
 	"#include <new>\n";
 
-// 4
-static const char *GSource2 =
+// 0
+static const char *GLoopInclude =
+	"#if defined(__AVX2__)\n"                                                 \
+	"#include <immintrin.h>\n"                                                \
+	"#elif defined(__SSE2__)\n"                                               \
+	"#include <emmintrin.h>\n"                                                \
+	"#endif\n"                                                                \
 	"\n"                                                                      \
+	"#if defined(__AVX2__) || defined(__SSE2__)\n"                            \
+	"#if defined(_MSC_VER)\n"                                                 \
+	"#include <intrin.h>\n"                                                   \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tIndex of the lowest set bit in bits, which is not zero\n"            \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"static inline uint32_t FirstBit(uint32_t bits)\n"                        \
+	"{\n"                                                                     \
+	"#if defined(_MSC_VER)\n"                                                 \
+	"\tunsigned long index;\n"                                                \
+	"\t_BitScanForward(&index,bits);\n"                                       \
+	"\treturn (uint32_t)index;\n"                                             \
+	"#else\n"                                                                 \
+	"\treturn (uint32_t)__builtin_ctz(bits);\n"                               \
+	"#endif\n"                                                                \
+	"}\n"                                                                     \
+	"#endif\n";
+
+// 11
+static const char *GSource2 =
 	"/************************************************************************/\n" \
 	"/*                                                                      */\n" \
 	"/*  Construction/Destruction                                            */\n" \
@@ -163,33 +391,47 @@ static const char *GSource2 =
 	"\n"                                                                      \
 	"/*\t%s::%s\n"                                                            \
 	" *\n"                                                                    \
-	" *\t\tConstructor\n"                                                     \
+	" *\t\tConstructors. A lexer reading a file fills a window allocated here;\n" \
+	" *\ta lexer reading input already in memory, such as a file mapped with\n" \
+	" *\tOCMappedFile, reads the data in place, and tokens are read from it\n" \
+	" *\tdirectly, so the data must last as long as the lexer does. Data of 2GB\n" \
+	" *\tor more does not fit the window\'s offsets, and is read as empty input\n" \
+	" *\twith abort set.\n"                                                   \
 	" */\n"                                                                   \
 	"\n"                                                                      \
-	"%s::%s(OCFileInput *f)\n"                                                \
+	"%s::%s(OCFileInput *f) : %s(f,NULL,0)\n"                                 \
 	"{\n"                                                                     \
-	"\tfile = f;\n"                                                           \
-	"\n"                                                                      \
-	"\tisMarked = false;\n"                                                   \
-	"\n"                                                                      \
-	"\tmarkSize = 0;\n"                                                       \
-	"\tmarkAlloc = 256;\n"                                                    \
-	"\tmarkBuffer = (unsigned char *)malloc(markAlloc);\n"                    \
+	"}\n"                                                                     \
 	"\n"                                                                      \
-	"\treadPos = 0;\n"                                                        \
-	"\treadSize = 0;\n"                                                       \
-	"\treadAlloc = 256;\n"                                                    \
-	"\treadBuffer = (unsigned char *)malloc(readAlloc);\n"                    \
+	"%s::%s(const char *data, size_t len) : %s((OCFileInput *)NULL,data,len)\n" \
+	"{\n"                                                                     \
+	"}\n"                                                                     \
 	"\n"                                                                      \
-	"\ttextMarkSize = 0;\n"                                                   \
-	"\ttextSize = 0;\n"                                                       \
-	"\ttextAlloc = 256;\n"                                                    \
-	"\ttextBuffer = (unsigned char *)malloc(textAlloc);\n"                    \
+	"%s::%s(OCFileInput *f, const char *data, size_t len)\n"                  \
+	"{\n"                                                                     \
+	"\tfile = f;\n"                                                           \
+	"\tbulk = (f == NULL) || f->canRead();\n"                                 \
+	"\n"                                                                      \
+	"\tif (f != NULL) {\n"                                                    \
+	"\t\tbufferSize = 0;\n"                                                   \
+	"\t\tbufferAlloc = 16384;\n"                                              \
+	"\t\tbuffer = (unsigned char *)malloc(bufferAlloc);\n"                    \
+	"\t} else if (len <= (size_t)INT32_MAX) {\n"                              \
+	"\t\tbuffer = (unsigned char *)data;\t\t// never written to\n"            \
+	"\t\tbufferSize = (int32_t)len;\n"                                        \
+	"\t\tbufferAlloc = 0;\n"                                                  \
+	"\t} else {\n"                                                            \
+	"\t\tbuffer = NULL;\n"                                                    \
+	"\t\tbufferSize = 0;\n"                                                   \
+	"\t\tbufferAlloc = 0;\n"                                                  \
+	"\t\tabort = \"Input is too large to read from memory\";\n"               \
+	"\t}\n"                                                                   \
 	"\n"                                                                      \
-	"\tcurLine = 0;\n"                                                        \
-	"\tcurColumn = 0;\n"                                                      \
+	"\ttokenStart = 0;\n"                                                     \
+	"\tcursor = 0;\n"                                                         \
+	"\tmarkPos = 0;\n"                                                        \
 	"\n"                                                                      \
-	"\tstates = 0;\n";
+	"%s\tstates = 0;\n";
 
 // 4
 static const char *GSource3 =
@@ -202,121 +444,45 @@ static const char *GSource3 =
 	"\n"                                                                      \
 	"%s::~%s(void)\n"                                                         \
 	"{\n"                                                                     \
-	"\tif (markBuffer) free(markBuffer);\n"                                   \
-	"\tif (readBuffer) free(readBuffer);\n"                                   \
-	"\tif (textBuffer) free(textBuffer);\n";
+	"\tif (bufferAlloc > 0) free(buffer);\n";
 
-// 10
+// 13
 static const char *GSource4 =
 	"}\n"                                                                     \
 	"\n"                                                                      \
 	"/*\n"                                                                    \
 	" *\tInternal read backtrack support. We implement the internal methods\n" \
-	" *\tfor mark, unmark and reset to note the current file position. This is\n" \
-	" *\tused by the lexer to unwind the read queue if we overread the number\n" \
-	" *\tof characters during parsing\n"                                      \
+	" *\tfor mark and reset to note the current file position. This is used by\n" \
+	" *\tthe lexer to unwind the read position if we overread the number of\n" \
+	" *\tcharacters during parsing\n"                                         \
 	" *\n"                                                                    \
 	" *\tIn essence, as we execute the DFA while we read characters, when we\n" \
 	" *\tfind an end state, we mark the stream. Then we continue to read until\n" \
 	" *\twe reach an error--at which point we rewind back to the mark location.\n" \
+	" *\tEverything read since the start of the token stays in the input window,\n" \
+	" *\tso neither has to copy anything.\n"                                  \
 	" */\n"                                                                   \
 	"\n"                                                                      \
 	"/*\t%s::mark\n"                                                          \
 	" *\n"                                                                    \
-	" *\t\tMark: note that we should cache characters being read so we can rewind\n" \
-	" *\tto this location in the future\n"                                    \
+	" *\t\tMark: note the current location as the end of the token, so we can\n" \
+	" *\trewind to it in the future\n"                                        \
 	" */\n"                                                                   \
 	"\n"                                                                      \
 	"void %s::mark(void)\n"                                                   \
 	"{\n"                                                                     \
-	"\t/*\n"                                                                  \
-	"\t *\tStore the current file location and enable marking. This has the side\n" \
-	"\t *\teffect of flushing any previous mark buffer\n"                     \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tmarkLine = curLine;\n"                                                 \
-	"\tmarkColumn = curColumn;\n"                                             \
-	"\ttextMarkSize = textSize;\n"                                            \
-	"\n"                                                                      \
-	"\tisMarked = true;\n"                                                    \
-	"\tmarkSize = 0;\n"                                                       \
+	"%s\tmarkPos = cursor;\n"                                                 \
 	"}\n"                                                                     \
 	"\n"                                                                      \
 	"/*\t%s::reset\n"                                                         \
 	" *\n"                                                                    \
-	" *\t\tReset: reset the buffer positions\n"                               \
+	" *\t\tReset: rewind to the mark\n"                                       \
 	" */\n"                                                                   \
 	"\n"                                                                      \
 	"void %s::reset(void)\n"                                                  \
 	"{\n"                                                                     \
-	"\tif (!isMarked) return;\t// not marked, nothing to do.\n"               \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tReset to the marked position. We maintain two mutable data objects,\n" \
-	"\t *\tone which stores the data we\'re reading from (if any), and one which\n" \
-	"\t *\tstores the marked data.\n"                                         \
-	"\t *\n"                                                                  \
-	"\t *\tReset does two things: it prepends the read buffer with the data we\n" \
-	"\t *\tstored during the mark phase, and we clear the mark flag.\n"       \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tif (markSize + readSize - readPos > readAlloc) {\n"                    \
-	"\t\t/*\n"                                                                \
-	"\t\t *\tResize to fit\n"                                                 \
-	"\t\t */\n"                                                               \
-	"\n"                                                                      \
-	"\t\tint32_t toFit = markSize + readSize - readPos;\n"                    \
-	"\t\ttoFit = (toFit + 255) & ~255;\t// align to 256 byte boundary\n"      \
-	"\t\tif (toFit < 0) toFit = 256;\n"                                       \
-	"\n"                                                                      \
-	"\t\tunsigned char *ptr = (unsigned char *)realloc(readBuffer, toFit);\n" \
-	"\t\tif (ptr == NULL) {\n"                                                \
-	"\t\t\tthrow std::bad_alloc();\n"                                         \
-	"\t\t}\n"                                                                 \
-	"\n"                                                                      \
-	"\t\treadBuffer = ptr;\n"                                                 \
-	"\t\treadAlloc = toFit;\n"                                                \
-	"\t}\n"                                                                   \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tMove the contents of the read buffer to a location above where the\n" \
-	"\t *\tmark queue will go\n"                                              \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tif (readPos < readSize) {\n"                                           \
-	"\t\tmemmove(markSize + readBuffer, readPos + readBuffer, readSize - readPos);\n" \
-	"\t}\n"                                                                   \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tMove the marked data\n"                                            \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tif (markSize > 0) {\n"                                                 \
-	"\t\tmemmove(readBuffer, markBuffer, markSize);\n"                        \
-	"\t}\n"                                                                   \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tUpdate the read buffer settings\n"                                 \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\treadSize = markSize + readSize - readPos;\n"                           \
-	"\treadPos = 0;\n"                                                        \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tClear the mark\n"                                                  \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tisMarked = false;\n"                                                   \
-	"\tmarkSize = 0;\n"                                                       \
-	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tUpdate the file position\n"                                        \
-	"\t */\n"                                                                 \
-	"\n"                                                                      \
-	"\tcurLine = markLine;\n"                                                 \
-	"\tcurColumn = markColumn;\n"                                             \
-	"\ttextSize = textMarkSize;\n"                                            \
-	"}\n"                                                                     \
+	"\tcursor = markPos;\n"                                                   \
+	"%s}\n"                                                                   \
 	"\n"                                                                      \
 	"/*\n"                                                                    \
 	" *\tRead input stream.\n"                                                \
@@ -327,52 +493,72 @@ static const char *GSource4 =
 	"\tint ch;\n"                                                             \
 	"\n"                                                                      \
 	"\t/*\n"                                                                  \
-	"\t *\tLow level: read, if from marked buffer\n"                          \
+	"\t *\tLow level: read from the input window, refilling it when we reach\n" \
+	"\t *\tthe end\n"                                                         \
 	"\t */\n"                                                                 \
 	"\n"                                                                      \
-	"\tif (readPos < readSize) {\n"                                           \
-	"\t\tch = readBuffer[readPos++];\n"                                       \
-	"\t} else {\n"                                                            \
-	"\t\tch = file->readByte();\n"                                            \
-	"\n"                                                                      \
-	"\t\tif (ch == -1) return -1;\t\t// At EOF; immediate return.\n"          \
-	"\t}\n"                                                                   \
-	"\n"                                                                      \
+	"\tif ((cursor >= bufferSize) && !fill()) return -1;\t// At EOF\n"        \
+	"\tch = buffer[cursor++];\n"                                              \
+	"%s\n"                                                                    \
 	"\t/*\n"                                                                  \
-	"\t *\tUpdate file position\n"                                            \
+	"\t *\tReturn read character.\n"                                          \
 	"\t */\n"                                                                 \
 	"\n"                                                                      \
-	"\tif (ch == \'\\n\') {\n"                                                \
-	"\t\tcurColumn = 0;\n"                                                    \
-	"\t\t++curLine;\n"                                                        \
-	"\t} else {\n"                                                            \
-	"\t\t++curColumn;\n"                                                      \
-	"\t}\n"                                                                   \
+	"\treturn ch;\n"                                                          \
+	"}\n"                                                                     \
 	"\n"                                                                      \
-	"\t/*\n"                                                                  \
-	"\t *\tHandle mark\n"                                                     \
-	"\t */\n"                                                                 \
+	"/*\n"                                                                    \
+	" *\tRead more of the file into the input window, once everything in it has\n" \
+	" *\tbeen read. Nothing before the token being read is needed any more, so\n" \
+	" *\twhen the window runs short of room we slide the token down to the start;\n" \
+	" *\tif the token itself takes up half the window, we double it. Returns\n" \
+	" *\tfalse at EOF, or if we are reading from memory.\n"                   \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"bool %s::fill(void)\n"                                                   \
+	"{\n"                                                                     \
+	"\tif (file == NULL) return false;\n"                                     \
+	"\n"                                                                      \
+	"\tif (bufferSize > bufferAlloc / 2) {\n"                                 \
+	"\t\tif (tokenStart > 0) {\n"                                             \
+	"%s\t\t\tbufferSize -= tokenStart;\n"                                     \
+	"\t\t\tmemmove(buffer, buffer + tokenStart, bufferSize);\n"               \
+	"\t\t\tcursor -= tokenStart;\n"                                           \
+	"\t\t\tmarkPos -= tokenStart;\n"                                          \
+	"\t\t\ttokenStart = 0;\n"                                                 \
+	"\t\t}\n"                                                                 \
+	"\n"                                                                      \
+	"\t\tif (bufferSize > bufferAlloc / 2) {\n"                               \
+	"\t\t\tif (bufferAlloc > 0x3FFFFFFF) {\n"                                 \
+	"\t\t\t\tthrow std::bad_alloc();\n"                                       \
+	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
-	"\tif (isMarked) {\n"                                                     \
-	"\t\tif (markSize >= markAlloc) {\n"                                      \
-	"\t\t\tint32_t toFit = (markAlloc + 256) & ~255;\n"                       \
-	"\t\t\tif (toFit < 256) toFit = 256;\n"                                   \
-	"\t\t\tunsigned char *ptr = (unsigned char *)realloc(markBuffer, toFit);\n" \
+	"\t\t\tint32_t toFit = bufferAlloc * 2;\n"                                \
+	"\t\t\tunsigned char *ptr = (unsigned char *)realloc(buffer, toFit);\n"   \
 	"\t\t\tif (ptr == NULL) {\n"                                              \
 	"\t\t\t\tthrow std::bad_alloc();\n"                                       \
 	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
-	"\t\t\tmarkBuffer = ptr;\n"                                               \
-	"\t\t\tmarkAlloc = toFit;\n"                                              \
+	"\t\t\tbuffer = ptr;\n"                                                   \
+	"\t\t\tbufferAlloc = toFit;\n"                                            \
 	"\t\t}\n"                                                                 \
-	"\t\tmarkBuffer[markSize++] = (unsigned char)ch;\n"                       \
 	"\t}\n"                                                                   \
 	"\n"                                                                      \
 	"\t/*\n"                                                                  \
-	"\t *\tReturn read character.\n"                                          \
+	"\t *\tRead as much as fits, or a byte from a file which reads a byte at\n" \
+	"\t *\ta time\n"                                                          \
 	"\t */\n"                                                                 \
 	"\n"                                                                      \
-	"\treturn ch;\n"                                                          \
+	"\tif (bulk) {\n"                                                         \
+	"\t\tint32_t len = (int32_t)file->read(buffer + bufferSize, bufferAlloc - bufferSize);\n" \
+	"\t\tbufferSize += len;\n"                                                \
+	"\t\treturn len > 0;\n"                                                   \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tint ch = file->readByte();\n"                                          \
+	"\tif (ch == -1) return false;\n"                                         \
+	"\tbuffer[bufferSize++] = (unsigned char)ch;\n"                           \
+	"\treturn true;\n"                                                        \
 	"}\n"                                                                     \
 	"\n"                                                                      \
 	"/*\n"                                                                    \
@@ -381,54 +567,17 @@ static const char *GSource4 =
 	"\n"                                                                      \
 	"bool %s::atEOL()\n"                                                      \
 	"{\n"                                                                     \
-	"\tint ch;\n"                                                             \
-	"\n"                                                                      \
-	"\tif (readPos < readSize) {\n"                                           \
-	"\t\tch = readBuffer[readPos];\n"                                         \
-	"\t} else {\n"                                                            \
-	"\t\tch = file->peekByte();\n"                                            \
-	"\t}\n"                                                                   \
-	"\n"                                                                      \
-	"\tif ((ch == -1) || (ch == \'\\n\')) return true;\n"                     \
-	"\treturn false;\n"                                                       \
+	"\tif ((cursor >= bufferSize) && !fill()) return true;\t// At EOF\n"      \
+	"\treturn buffer[cursor] == \'\\n\';\n"                                   \
 	"}\n"                                                                     \
 	"\n"                                                                      \
 	"bool %s::atSOL()\n"                                                      \
 	"{\n"                                                                     \
-	"\treturn column == 0;\n"                                                 \
-	"}\n"                                                                     \
-	"\n"                                                                      \
-	"/*\n"                                                                    \
-	" *\tRead the state for the class/state combination. Decodes the sparce\n" \
-	" *\tmatrix that is compressed in StateMachineIA/JA/A above. If the\n"    \
-	" *\tentry is not found, returns MAXSTATES. This is the same as the lookup\n" \
-	" *\tStateMachine[class][state] if the StateMachine sparse array was\n"   \
-	" *\tunrolled\n"                                                          \
-	" */\n"                                                                   \
-	"\n"                                                                      \
-	"uint16_t %s::stateForClass(uint16_t charClass, uint16_t state)\n"        \
-	"{\n"                                                                     \
-	"\tsize_t min,max,mid;\n"                                                 \
-	"\n"                                                                      \
-	"\t/* Find range */\n"                                                    \
-	"\tmin = StateMachineIA[state];\n"                                        \
-	"\tmax = StateMachineIA[state+1];\n"                                      \
-	"\n"                                                                      \
-	"\t/* Binary search for value in ja */\n"                                 \
-	"\twhile (min < max) {\n"                                                 \
-	"\t\tmid = (min + max)/2;\n"                                              \
-	"\t\tuint16_t j = StateMachineJA[mid];\n"                                 \
-	"\t\tif (charClass == j) {\n"                                             \
-	"\t\t\treturn StateMachineA[mid];\n"                                      \
-	"\t\t} else if (charClass < j) {\n"                                       \
-	"\t\t\tmax = mid;\n"                                                      \
-	"\t\t} else {\n"                                                          \
-	"\t\t\tmin = mid+1;\n"                                                    \
-	"\t\t}\n"                                                                 \
-	"\t}\n"                                                                   \
-	"\treturn MAXSTATES;\n"                                                   \
-	"}\n"                                                                     \
-	"\n"                                                                      \
+	"%s}\n"                                                                   \
+	"\n";
+
+// 2
+static const char *GSourceFile =
 	"void %s::setFile(std::string &file, int32_t line)\n"                     \
 	"{\n"                                                                     \
 	"\tfilename = file;\n"                                                    \
@@ -445,38 +594,237 @@ static const char *GSource4 =
 	" */\n"                                                                   \
 	"\n";
 
-// 3
-static const char *GSource5 =
-	"/*\t%s::lex\n"                                                           \
-	" *\n"                                                                    \
-	" *\t\tLex interpreter. THis runs the state machine until we find something\n" \
-	" */\n"                                                                   \
-	"\n"                                                                      \
-	"int32_t %s::lex(void)\n"                                                 \
-	"{\n"                                                                     \
-	"\tuint16_t state;\n"                                                     \
-	"\tuint16_t action = MAXACTIONS;\n"                                       \
-	"\n"                                                                      \
-	"#ifdef %s_ValueDefined\n"                                                \
-	"\tmemset(&value,0,sizeof(value));\n"                                     \
-	"#endif\n"                                                                \
+// 0
+static const char *GLinesInit =
+	"\tcurLine = 0;\n"                                                        \
+	"\tcurColumn = 0;\n"                                                      \
+	"\n";
+
+// 0
+static const char *GOffsetInit =
+	"\tline = 0;\n"                                                           \
+	"\tcolumn = 0;\n"                                                         \
+	"\tbufferOffset = 0;\n"                                                   \
+	"\tindexed = 0;\n"                                                        \
+	"\n";
+
+// 0
+static const char *GLinesMark =
+	"\tmarkLine = curLine;\n"                                                 \
+	"\tmarkColumn = curColumn;\n";
+
+// 0
+static const char *GLinesReset =
+	"\tcurLine = markLine;\n"                                                 \
+	"\tcurColumn = markColumn;\n";
+
+// 0
+static const char *GLinesInput =
 	"\n"                                                                      \
 	"\t/*\n"                                                                  \
-	"\t *\tRun until we hit EOF or a production rule triggers a return\n"     \
+	"\t *\tUpdate file position\n"                                            \
 	"\t */\n"                                                                 \
 	"\n"                                                                      \
-	"\tfor (;;) {\n"                                                          \
-	"\t\t/*\n"                                                                \
-	"\t\t *\tStart running the DFA\n"                                         \
-	"\t\t */\n"                                                               \
+	"\tif (ch == \'\\n\') {\n"                                                \
+	"\t\tcurColumn = 0;\n"                                                    \
+	"\t\t++curLine;\n"                                                        \
+	"\t} else {\n"                                                            \
+	"\t\t++curColumn;\n"                                                      \
+	"\t}\n";
+
+// 0
+static const char *GOffsetSlide =
+	"\t\t\tindexLines(bufferOffset + tokenStart);\n"                          \
+	"\t\t\tbufferOffset += tokenStart;\n";
+
+// 0
+static const char *GLinesSOL =
+	"\treturn column == 0;\n";
+
+// 0
+static const char *GOffsetSOL =
+	"\tif (tokenStart > 0) return buffer[tokenStart - 1] == \'\\n\';\n"       \
 	"\n"                                                                      \
-	"\t\tstate = 0;\n"                                                        \
-	"\t\ttextSize = 0;\n"                                                     \
+	"\tint64_t start;\n"                                                      \
+	"\tcountLines(bufferOffset + tokenStart,start);\n"                        \
+	"\treturn start == bufferOffset + tokenStart;\n";
+
+// 10
+static const char *GOffsetFile =
+	"void %s::setFile(std::string &file, int32_t line)\n"                     \
+	"{\n"                                                                     \
+	"\tfilename = file;\n"                                                    \
+	"\tsetLine(line);\n"                                                      \
+	"}\n"                                                                     \
 	"\n"                                                                      \
-	"\t\tline = curLine;\n"                                                   \
-	"\t\tcolumn = curColumn;\n"                                               \
+	"/*\t%s::setLine\n"                                                       \
+	" *\n"                                                                    \
+	" *\t\tNote the line at the read position. Offsets before it keep the line\n" \
+	" *\tthey had.\n"                                                         \
+	" */\n"                                                                   \
 	"\n"                                                                      \
-	"\t\tfor (;;) {\n"                                                        \
+	"void %s::setLine(int32_t line)\n"                                        \
+	"{\n"                                                                     \
+	"\tint64_t offset = bufferOffset + cursor;\n"                             \
+	"\tint64_t start;\n"                                                      \
+	"\tint32_t base = line - (int32_t)countLines(offset,start);\n"            \
+	"\n"                                                                      \
+	"\tif (!lineSet.empty() && (lineSet.back().first == offset)) {\n"         \
+	"\t\tlineSet.back().second = base;\n"                                     \
+	"\t} else {\n"                                                            \
+	"\t\tlineSet.push_back(std::make_pair(offset,base));\n"                   \
+	"\t}\n"                                                                   \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\t%s::position\n"                                                      \
+	" *\n"                                                                    \
+	" *\t\tFind the line and column of an offset read so far, such as the\n"  \
+	" *\ttokenOffset() of a token\n"                                          \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::position(int64_t offset, int32_t &atLine, int32_t &atColumn)\n" \
+	"{\n"                                                                     \
+	"\tif (offset > bufferOffset + bufferSize) offset = bufferOffset + bufferSize;\n" \
+	"\n"                                                                      \
+	"\tint64_t start;\n"                                                      \
+	"\tsize_t count = countLines(offset,start);\n"                            \
+	"\n"                                                                      \
+	"\tint32_t base = 0;\n"                                                   \
+	"\tfor (size_t i = lineSet.size(); i > 0; --i) {\n"                       \
+	"\t\tif (lineSet[i - 1].first <= offset) {\n"                             \
+	"\t\t\tbase = lineSet[i - 1].second;\n"                                   \
+	"\t\t\tbreak;\n"                                                          \
+	"\t\t}\n"                                                                 \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tatLine = base + (int32_t)count;\n"                                     \
+	"\tatColumn = (int32_t)(offset - start);\n"                               \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tNewline index. Newlines are indexed in order, as we are asked for the\n" \
+	" *\tposition of an offset past them, or before the window slides past them.\n" \
+	" *\tFor each newline we note the low 16 bits of its offset, and for each\n" \
+	" *\t64K chunk of the file, the number of newlines before it.\n"          \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"/*\t%s::indexLines\n"                                                    \
+	" *\n"                                                                    \
+	" *\t\tIndex the newlines up to end, which must be in the input window. We\n" \
+	" *\ttest 16 or 32 characters at a time where we can.\n"                  \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::indexLines(int64_t end)\n"                                      \
+	"{\n"                                                                     \
+	"\tif (end <= indexed) return;\n"                                         \
+	"\n"                                                                      \
+	"\tconst unsigned char *buf = buffer + (indexed - bufferOffset);\n"       \
+	"\tsize_t len = (size_t)(end - indexed);\n"                               \
+	"\tsize_t n = 0;\n"                                                       \
+	"\n"                                                                      \
+	"#if defined(__AVX2__)\n"                                                 \
+	"\t__m256i nl = _mm256_set1_epi8(\'\\n\');\n"                             \
+	"\twhile (n + 32 <= len) {\n"                                             \
+	"\t\t__m256i x = _mm256_loadu_si256((const __m256i *)(buf + n));\n"       \
+	"\t\tuint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,nl));\n" \
+	"\t\twhile (bits) {\n"                                                    \
+	"\t\t\taddLine(indexed + n + FirstBit(bits));\n"                          \
+	"\t\t\tbits &= bits - 1;\n"                                               \
+	"\t\t}\n"                                                                 \
+	"\t\tn += 32;\n"                                                          \
+	"\t}\n"                                                                   \
+	"#elif defined(__SSE2__)\n"                                               \
+	"\t__m128i nl = _mm_set1_epi8(\'\\n\');\n"                                \
+	"\twhile (n + 16 <= len) {\n"                                             \
+	"\t\t__m128i x = _mm_loadu_si128((const __m128i *)(buf + n));\n"          \
+	"\t\tuint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x,nl));\n" \
+	"\t\twhile (bits) {\n"                                                    \
+	"\t\t\taddLine(indexed + n + FirstBit(bits));\n"                          \
+	"\t\t\tbits &= bits - 1;\n"                                               \
+	"\t\t}\n"                                                                 \
+	"\t\tn += 16;\n"                                                          \
+	"\t}\n"                                                                   \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"\tfor (; n < len; ++n) {\n"                                              \
+	"\t\tif (buf[n] == \'\\n\') addLine(indexed + n);\n"                      \
+	"\t}\n"                                                                   \
+	"\tindexed = end;\n"                                                      \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"void %s::addLine(int64_t offset)\n"                                      \
+	"{\n"                                                                     \
+	"\tsize_t chunk = (size_t)(offset >> 16);\n"                              \
+	"\twhile (lineChunk.size() <= chunk) {\n"                                 \
+	"\t\tlineChunk.push_back((uint32_t)lineEnds.size());\n"                   \
+	"\t}\n"                                                                   \
+	"\tlineEnds.push_back((uint16_t)offset);\n"                               \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\t%s::countLines\n"                                                    \
+	" *\n"                                                                    \
+	" *\t\tReturn the number of newlines before offset, which must be in the\n" \
+	" *\tinput window or indexed, and the offset of the start of its line\n"  \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"size_t %s::countLines(int64_t offset, int64_t &start)\n"                 \
+	"{\n"                                                                     \
+	"\tindexLines(offset);\n"                                                 \
+	"\n"                                                                      \
+	"\tsize_t chunk = (size_t)(offset >> 16);\n"                              \
+	"\tsize_t lo = lineEnds.size();\n"                                        \
+	"\tsize_t hi = lo;\n"                                                     \
+	"\tif (chunk < lineChunk.size()) {\n"                                     \
+	"\t\tlo = lineChunk[chunk];\n"                                            \
+	"\t\tif (chunk + 1 < lineChunk.size()) hi = lineChunk[chunk + 1];\n"      \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tstd::vector<uint16_t>::iterator end = lineEnds.begin() + hi;\n"        \
+	"\tsize_t count = std::lower_bound(lineEnds.begin() + lo,end,(uint16_t)offset) - lineEnds.begin();\n" \
+	"\n"                                                                      \
+	"\tstart = 0;\n"                                                          \
+	"\tif (count > 0) {\n"                                                    \
+	"\t\t// The chunk of the last newline before offset\n"                    \
+	"\t\tsize_t last = std::upper_bound(lineChunk.begin(),lineChunk.end(),(uint32_t)(count - 1)) - lineChunk.begin() - 1;\n" \
+	"\t\tstart = ((int64_t)last << 16) + lineEnds[count - 1] + 1;\n"          \
+	"\t}\n"                                                                   \
+	"\treturn count;\n"                                                       \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tInternal methods declared within the Lex file\n"                     \
+	" */\n"                                                                   \
+	"\n";
+
+// 8
+static const char *GSource5 =
+	"/*\t%s::lex\n"                                                           \
+	" *\n"                                                                    \
+	" *\t\tLex interpreter. THis runs the state machine until we find something\n" \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"int32_t %s::lex(void)\n"                                                 \
+	"{\n"                                                                     \
+	"\tuint32_t state;\n"                                                     \
+	"\tuint32_t action = MAXACTIONS;\n"                                       \
+	"\n"                                                                      \
+	"#ifdef %s_ValueDefined\n"                                                \
+	"\tmemset(&value,0,sizeof(value));\n"                                     \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tRun until we hit EOF or a production rule triggers a return\n"     \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tfor (;;) {\n"                                                          \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tStart running the DFA\n"                                         \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tstate = 0;\n"                                                        \
+	"\t\ttokenStart = cursor;\n"                                              \
+	"\n"                                                                      \
+	"%s\t\tfor (;;) {\n"                                                      \
 	"\t\t\tint ch = input();\n"                                               \
 	"\t\t\tif (ch == -1) {\n"                                                 \
 	"\t\t\t\t/*\n"                                                            \
@@ -485,7 +833,7 @@ static const char *GSource5 =
 	"\t\t\t\t *\tillegal state transition.\n"                                 \
 	"\t\t\t\t */\n"                                                           \
 	"\n"                                                                      \
-	"\t\t\t\tif (textSize == 0) return -1;\n"                                 \
+	"\t\t\t\tif (cursor == tokenStart) return -1;\n"                          \
 	"\t\t\t\tbreak;\n"                                                        \
 	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
@@ -493,38 +841,166 @@ static const char *GSource5 =
 	"\t\t\t *\tAttempt to transition to the next state\n"                     \
 	"\t\t\t */\n"                                                             \
 	"\n"                                                                      \
-	"\t\t\tuint16_t charClass = CharClass[ch];\n"                             \
-	"\t\t\tuint16_t newState = stateForClass(charClass, state);\n"            \
+	"\t\t\tuint32_t newState = stateForClass(%s, state);\n"                   \
 	"\t\t\tif (newState >= MAXSTATES) {\n"                                    \
 	"\t\t\t\t/* Illegal state transition */\n"                                \
 	"\t\t\t\tbreak;\n"                                                        \
 	"\t\t\t}\n"                                                               \
 	"\n"                                                                      \
 	"\t\t\t/*\n"                                                              \
-	"\t\t\t *\tStore the character we read, and transition to the next\n"     \
-	"\t\t\t *\tstate\n"                                                       \
+	"\t\t\t *\tTransition to the next state. The character we read stays\n"   \
+	"\t\t\t *\tin the input window as part of the token.\n"                   \
 	"\t\t\t */\n"                                                             \
 	"\n"                                                                      \
 	"\t\t\tstate = newState;\n"                                               \
 	"\n"                                                                      \
-	"\t\t\tif (textSize >= textAlloc) {\n"                                    \
-	"\t\t\t\tint32_t toFit = (textAlloc + 256) & ~255;\n"                     \
-	"\t\t\t\tif (toFit < 256) toFit = 256;\n"                                 \
-	"\t\t\t\tunsigned char *ptr = (unsigned char *)realloc(textBuffer, toFit);\n" \
-	"\t\t\t\tif (ptr == NULL) {\n"                                            \
-	"\t\t\t\t\tthrow std::bad_alloc();\n"                                     \
+	"\t\t\t/*\n"                                                              \
+	"\t\t\t *\tNote the current action if we have one\n"                      \
+	"\t\t\t */\n"                                                             \
+	"\n"                                                                      \
+	"\t\t\tuint32_t newAction = %s;\n"                                        \
+	"\t\t\tif (newAction > MAXACTIONS) {\n"                                   \
+	"\t\t\t\tnewAction = conditionalAction(newAction);\n"                     \
+	"\t\t\t}\n"                                                               \
+	"\t\t\tif (newAction != MAXACTIONS) {\n"                                  \
+	"\t\t\t\taction = newAction;\n"                                           \
+	"\t\t\t\tmark();\n"                                                       \
+	"%s\t\t\t}\n"                                                             \
+	"%s\t\t}\n"                                                               \
+	"\n";
+
+// 0
+static const char *GLoopCall =
+	"\n"                                                                      \
+	"\t\t\t/*\n"                                                              \
+	"\t\t\t *\tIf this state loops back to itself, read the rest of the run\n" \
+	"\t\t\t */\n"                                                             \
+	"\n"                                                                      \
+	"\t\t\tif (StateLoop[state] < MAXLOOPS) loop(state);\n";
+
+// 0
+static const char *GStateStop =
+	"\t\t\t\tif (StateStop[state]) break;\n";
+
+// 0
+static const char *GLinesStart =
+	"\t\tline = curLine;\n"                                                   \
+	"\t\tcolumn = curColumn;\n"                                               \
+	"\n";
+
+// 4
+static const char *GCodeSource5 =
+	"/*\t%s::lex\n"                                                           \
+	" *\n"                                                                    \
+	" *\t\tLex interpreter. The DFA is written as code: each state reads the\n" \
+	" *\tnext character and jumps directly to the state it transitions to.\n" \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"int32_t %s::lex(void)\n"                                                 \
+	"{\n"                                                                     \
+	"\tuint32_t action = MAXACTIONS;\n"                                       \
+	"\tint ch;\n"                                                             \
+	"\n"                                                                      \
+	"#ifdef %s_ValueDefined\n"                                                \
+	"\tmemset(&value,0,sizeof(value));\n"                                     \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tRun until we hit EOF or a production rule triggers a return\n"     \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tfor (;;) {\n"                                                          \
+	"\t\ttokenStart = cursor;\n"                                              \
+	"\n"                                                                      \
+	"%s\t\t/*\n"                                                              \
+	"\t\t *\tRun the DFA. Entering a state notes its action, if it has one;\n" \
+	"\t\t *\twe stop when there is no transition or at EOF.\n"                \
+	"\t\t */\n"                                                               \
+	"\n";
+
+// 7
+static const char *GPairSource5 =
+	"/*\t%s::lex\n"                                                           \
+	" *\n"                                                                    \
+	" *\t\tLex interpreter. This runs the state machine until we find something.\n" \
+	" *\tWhere it can, it takes two characters at a time through the pair table.\n" \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"int32_t %s::lex(void)\n"                                                 \
+	"{\n"                                                                     \
+	"\tuint32_t state;\n"                                                     \
+	"\tuint32_t action = MAXACTIONS;\n"                                       \
+	"\n"                                                                      \
+	"#ifdef %s_ValueDefined\n"                                                \
+	"\tmemset(&value,0,sizeof(value));\n"                                     \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tRun until we hit EOF or a production rule triggers a return\n"     \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tfor (;;) {\n"                                                          \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tStart running the DFA\n"                                         \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tstate = 0;\n"                                                        \
+	"\t\ttokenStart = cursor;\n"                                              \
+	"\n"                                                                      \
+	"%s\t\tfor (;;) {\n"                                                      \
+	"\t\t\tint ch = input();\n"                                               \
+	"\t\t\tif (ch == -1) {\n"                                                 \
+	"\t\t\t\t/*\n"                                                            \
+	"\t\t\t\t *\tWe\'ve hit EOF. If there is no stored text, we assume\n"     \
+	"\t\t\t\t *\twe\'re at the file EOF, so return EOF. Otherwise treat as\n" \
+	"\t\t\t\t *\tillegal state transition.\n"                                 \
+	"\t\t\t\t */\n"                                                           \
+	"\n"                                                                      \
+	"\t\t\t\tif (cursor == tokenStart) return -1;\n"                          \
+	"\t\t\t\tbreak;\n"                                                        \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\t\t/*\n"                                                              \
+	"\t\t\t *\tRead the next character too, and try to take both in one\n"    \
+	"\t\t\t *\tstep. If the first character moves to a state with an\n"       \
+	"\t\t\t *\taction, the pair table gives it, and we note it and mark the\n" \
+	"\t\t\t *\tinput between the two. The pair table has no entry if there\n" \
+	"\t\t\t *\tis no transition, or if the first state\'s action depends on\n" \
+	"\t\t\t *\tstart conditions; then we put the next character back and\n"   \
+	"\t\t\t *\ttake a single step.\n"                                         \
+	"\t\t\t */\n"                                                             \
+	"\n"                                                                      \
+	"\t\t\tuint32_t charClass = CharClass[ch];\n"                             \
+	"\t\t\tuint32_t pair = MAXSTATES;\n"                                      \
+	"\n"                                                                      \
+	"%s\t\t\tint next = input();\n"                                           \
+	"\t\t\tif (next != -1) {\n"                                               \
+	"\t\t\t\tpair = PairMachine[(state * (MAXCHARCLASS + 1) + charClass) * (MAXCHARCLASS + 1) + CharClass[next]];\n" \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\t\tuint32_t newState = pair & PAIRSTATE;\n"                           \
+	"\t\t\tif (newState < MAXSTATES) {\n"                                     \
+	"\t\t\t\tuint32_t midAction = pair >> PAIRSHIFT;\n"                       \
+	"\t\t\t\tif (midAction != MAXACTIONS) {\n"                                \
+	"\t\t\t\t\taction = midAction;\n"                                         \
+	"\t\t\t\t\tmarkPair(%s);\n"                                               \
 	"\t\t\t\t}\n"                                                             \
+	"\t\t\t} else {\n"                                                        \
+	"\t\t\t\tif (next != -1) unput(%s);\n"                                    \
 	"\n"                                                                      \
-	"\t\t\t\ttextBuffer = ptr;\n"                                             \
-	"\t\t\t\ttextAlloc = toFit;\n"                                            \
+	"\t\t\t\tnewState = stateForClass(charClass, state);\n"                   \
+	"\t\t\t\tif (newState >= MAXSTATES) {\n"                                  \
+	"\t\t\t\t\t/* Illegal state transition */\n"                              \
+	"\t\t\t\t\tbreak;\n"                                                      \
+	"\t\t\t\t}\n"                                                             \
 	"\t\t\t}\n"                                                               \
-	"\t\t\ttextBuffer[textSize++] = (char)ch;\n"                              \
+	"\t\t\tstate = newState;\n"                                               \
 	"\n"                                                                      \
 	"\t\t\t/*\n"                                                              \
 	"\t\t\t *\tNote the current action if we have one\n"                      \
 	"\t\t\t */\n"                                                             \
 	"\n"                                                                      \
-	"\t\t\tuint16_t newAction = StateActions[state];\n"                       \
+	"\t\t\tuint32_t newAction = StateActions[state];\n"                       \
 	"\t\t\tif (newAction > MAXACTIONS) {\n"                                   \
 	"\t\t\t\tnewAction = conditionalAction(newAction);\n"                     \
 	"\t\t\t}\n"                                                               \
@@ -533,7 +1009,11 @@ static const char *GSource5 =
 	"\t\t\t\tmark();\n"                                                       \
 	"\t\t\t}\n"                                                               \
 	"\t\t}\n"                                                                 \
-	"\n"                                                                      \
+	"\n";
+
+
+// 1
+static const char *GSourceAction =
 	"\t\t/*\n"                                                                \
 	"\t\t *\tIf no action is set, we simply abort after setting an internal\n" \
 	"\t\t *\terror state. This should never happen in a well designed lexer\n" \
@@ -549,219 +1029,1544 @@ static const char *GSource5 =
 	"\t\t */\n"                                                               \
 	"\n"                                                                      \
 	"\t\treset();\n"                                                          \
-	"\t\tif (textSize == 0) {\n"                                              \
+	"\t\tif (cursor == tokenStart) {\n"                                       \
 	"\t\t\tabort = \"No characters read in sequence\";\n"                     \
 	"\t\t\treturn -1;\n"                                                      \
 	"\t\t}\n"                                                                 \
 	"\n"                                                                      \
+	"%s\t\t/*\n"                                                              \
+	"\t\t *\tExecute action\n"                                                \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tswitch (action) {\n";
+
+// 0
+static const char *GSourceText =
 	"\t\t/*\n"                                                                \
 	"\t\t *\tConvert text sequence into string\n"                             \
 	"\t\t */\n"                                                               \
 	"\n"                                                                      \
-	"\t\ttext = std::string((char *)textBuffer,textSize);\n"                  \
+	"\t\ttext = std::string((char *)buffer + tokenStart,cursor - tokenStart);\n" \
+	"\n";
+
+static const char *GSource6 =
+	"\t\t\tdefault:\n"                                                        \
+	"\t\t\t\tbreak;\n"                                                        \
+	"\t\t}\n"                                                                 \
+	"\t}\n"                                                                   \
+	"}\n"                                                                     \
+	"\n";
+
+
+/************************************************************************/
+/*																		*/
+/*	State Lookup														*/
+/*																		*/
+/************************************************************************/
+
+// 1
+static const char *GSourceTable =
+	"/*\n"                                                                    \
+	" *\tRead the state for the class/state combination from the row\n"       \
+	" *\tdisplacement tables above. If the entry is not ours, there is no\n"  \
+	" *\ttransition, and we return MAXSTATES. This is the same as the lookup\n" \
+	" *\tStateMachine[class][state] if the StateMachine array was unrolled.\n" \
+	" *\tThe tables have room for a class of MAXCHARCLASS past any base.\n"   \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"uint32_t %s::stateForClass(uint32_t charClass, uint32_t state)\n"        \
+	"{\n"                                                                     \
+	"\tuint32_t base = StateMachineBase[state];\n"                            \
+	"\tuint32_t index = base + charClass;\n"                                  \
 	"\n"                                                                      \
-	"\t\t/*\n"                                                                \
-	"\t\t *\tExecute action\n"                                                \
-	"\t\t */\n"                                                               \
+	"\tif (StateMachineCheck[index] != base) return MAXSTATES;\n"             \
+	"\treturn StateMachineNext[index];\n"                                     \
+	"}\n"                                                                     \
+	"\n";
+
+// 1
+static const char *GSourceDense =
+	"/*\n"                                                                    \
+	" *\tRead the state for the class/state combination from the dense table\n" \
+	" *\tabove. Each row has a column past MAXCHARCLASS for characters which\n" \
+	" *\tare in no class. Returns MAXSTATES if there is no transition.\n"     \
+	" */\n"                                                                   \
 	"\n"                                                                      \
-	"\t\tswitch (action) {\n";
+	"uint32_t %s::stateForClass(uint32_t charClass, uint32_t state)\n"        \
+	"{\n"                                                                     \
+	"\treturn StateMachine[state * (MAXCHARCLASS + 1) + charClass];\n"        \
+	"}\n"                                                                     \
+	"\n";
+
+// 1
+static const char *GSourceByte =
+	"/*\n"                                                                    \
+	" *\tRead the state for the character/state combination. The table above\n" \
+	" *\tis indexed by the character itself rather than its character class,\n" \
+	" *\tso charClass is the character read. Returns MAXSTATES if there is no\n" \
+	" *\ttransition.\n"                                                       \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"uint32_t %s::stateForClass(uint32_t charClass, uint32_t state)\n"        \
+	"{\n"                                                                     \
+	"\treturn StateMachine[((uint32_t)state << 8) | charClass];\n"            \
+	"}\n"                                                                     \
+	"\n";
+
+// 6
+static const char *GSourcePair =
+	"/*\n"                                                                    \
+	" *\tPair support. If we read the character after a pair\'s first, and\n" \
+	" *\tcannot take both at once, we unput the second, restoring the position\n" \
+	" *\tbefore it was read. markPair marks the input between the two characters\n" \
+	" *\tof a pair we took, as if mark had been called before the second was\n" \
+	" *\tread.\n"                                                             \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::unput(%s)\n"                                                    \
+	"{\n"                                                                     \
+	"\t--cursor;\t\t\t\t\t\t\t\t// still in the window\n"                     \
+	"%s}\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::markPair(%s)\n"                                                 \
+	"{\n"                                                                     \
+	"%s\tmarkPos = cursor - 1;\n"                                             \
+	"}\n"                                                                     \
+	"\n";
+
+// 0
+static const char *GLinesMid =
+	"\t\t\tint32_t midLine = curLine;\n"                                      \
+	"\t\t\tint32_t midColumn = curColumn;\n";
+
+// 0
+static const char *GLinesUnput =
+	"\tcurLine = line;\n"                                                     \
+	"\tcurColumn = column;\n";
+
+// 0
+static const char *GLinesMarkPair =
+	"\tmarkLine = line;\n"                                                    \
+	"\tmarkColumn = column;\n";
+
+// 4
+static const char *GSourceLoop =
+	"/************************************************************************/\n" \
+	"/*                                                                      */\n" \
+	"/*  Self Loops                                                          */\n" \
+	"/*                                                                      */\n" \
+	"/************************************************************************/\n" \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tFind the length of the run at the start of the buffer of characters\n" \
+	" *\twhich loop back to the state. The set for each loop is up to four\n" \
+	" *\tranges of characters, or everything outside those ranges, so we can\n" \
+	" *\ttest 16 or 32 characters at a time. A character c is in the range\n" \
+	" *\t[lo, lo + span] if (unsigned char)(c - lo) <= span. Unused ranges\n" \
+	" *\trepeat the first.\n"                                                 \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"static size_t LoopSpan(const unsigned char *buf, size_t len, uint32_t index)\n" \
+	"{\n"                                                                     \
+	"\tconst uint8_t *set = LoopSet + index * 32;\n"                          \
+	"\tsize_t n = 0;\n"                                                       \
+	"\n"                                                                      \
+	"#if defined(__AVX2__)\n"                                                 \
+	"\tconst uint8_t *range = LoopRange + index * 9;\n"                       \
+	"\t__m256i zero = _mm256_setzero_si256();\n"                              \
+	"\t__m256i invert = _mm256_set1_epi8(range[8] ? -1 : 0);\n"               \
+	"\t__m256i lo[4],span[4];\n"                                              \
+	"\tfor (int i = 0; i < 4; ++i) {\n"                                       \
+	"\t\tlo[i] = _mm256_set1_epi8((char)range[i * 2]);\n"                     \
+	"\t\tspan[i] = _mm256_set1_epi8((char)range[i * 2 + 1]);\n"               \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\twhile (n + 32 <= len) {\n"                                             \
+	"\t\t__m256i x = _mm256_loadu_si256((const __m256i *)(buf + n));\n"       \
+	"\t\t__m256i in = zero;\n"                                                \
+	"\t\tfor (int i = 0; i < 4; ++i) {\n"                                     \
+	"\t\t\t__m256i d = _mm256_subs_epu8(_mm256_sub_epi8(x,lo[i]),span[i]);\n" \
+	"\t\t\tin = _mm256_or_si256(in,_mm256_cmpeq_epi8(d,zero));\n"             \
+	"\t\t}\n"                                                                 \
+	"\t\tuint32_t bits = ~(uint32_t)_mm256_movemask_epi8(_mm256_xor_si256(in,invert));\n" \
+	"\t\tif (bits) return n + FirstBit(bits);\n"                              \
+	"\t\tn += 32;\n"                                                          \
+	"\t}\n"                                                                   \
+	"#elif defined(__SSE2__)\n"                                               \
+	"\tconst uint8_t *range = LoopRange + index * 9;\n"                       \
+	"\t__m128i zero = _mm_setzero_si128();\n"                                 \
+	"\t__m128i invert = _mm_set1_epi8(range[8] ? -1 : 0);\n"                  \
+	"\t__m128i lo[4],span[4];\n"                                              \
+	"\tfor (int i = 0; i < 4; ++i) {\n"                                       \
+	"\t\tlo[i] = _mm_set1_epi8((char)range[i * 2]);\n"                        \
+	"\t\tspan[i] = _mm_set1_epi8((char)range[i * 2 + 1]);\n"                  \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\twhile (n + 16 <= len) {\n"                                             \
+	"\t\t__m128i x = _mm_loadu_si128((const __m128i *)(buf + n));\n"          \
+	"\t\t__m128i in = zero;\n"                                                \
+	"\t\tfor (int i = 0; i < 4; ++i) {\n"                                     \
+	"\t\t\t__m128i d = _mm_subs_epu8(_mm_sub_epi8(x,lo[i]),span[i]);\n"       \
+	"\t\t\tin = _mm_or_si128(in,_mm_cmpeq_epi8(d,zero));\n"                   \
+	"\t\t}\n"                                                                 \
+	"\t\tuint32_t bits = 0xFFFF & ~(uint32_t)_mm_movemask_epi8(_mm_xor_si128(in,invert));\n" \
+	"\t\tif (bits) return n + FirstBit(bits);\n"                              \
+	"\t\tn += 16;\n"                                                          \
+	"\t}\n"                                                                   \
+	"#endif\n"                                                                \
+	"\n"                                                                      \
+	"\twhile ((n < len) && (set[buf[n] >> 3] & (1 << (buf[n] & 7)))) ++n;\n"  \
+	"\treturn n;\n"                                                           \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\t%s::loop\n"                                                          \
+	" *\n"                                                                    \
+	" *\t\tRead the rest of a run of characters which loop back to this state,\n" \
+	" *\tas lex() would, but without stepping the state machine for each. The\n" \
+	" *\tfirst character past the run is left to be read next. Loop states have\n" \
+	" *\tno conditional rules, so if the state has an action we mark once at the\n" \
+	" *\tend.\n"                                                              \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::loop(uint32_t state)\n"                                         \
+	"{\n"                                                                     \
+	"\tuint32_t index = StateLoop[state];\n"                                  \
+	"\n"                                                                      \
+	"\tif (bulk) {\n"                                                         \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tTake the run from the input window, reading more of the file\n"  \
+	"\t\t *\tuntil we find the first character past the run\n"                \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tfor (;;) {\n"                                                        \
+	"\t\t\tif ((cursor >= bufferSize) && !fill()) break;\n"                   \
+	"\n"                                                                      \
+	"\t\t\tconst unsigned char *run = buffer + cursor;\n"                     \
+	"\t\t\tint32_t len = (int32_t)LoopSpan(run,bufferSize - cursor,index);\n" \
+	"\t\t\tcursor += len;\n"                                                  \
+	"%s\n"                                                                    \
+	"\t\t\tif (cursor < bufferSize) break;\n"                                 \
+	"\t\t}\n"                                                                 \
+	"\t} else {\n"                                                            \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tA file which reads a byte at a time we test a byte at a time\n"  \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tconst uint8_t *set = LoopSet + index * 32;\n"                        \
+	"\t\twhile ((cursor < bufferSize) || fill()) {\n"                         \
+	"\t\t\tint ch = buffer[cursor];\n"                                        \
+	"\t\t\tif (!(set[ch >> 3] & (1 << (ch & 7)))) break;\n"                   \
+	"\t\t\t++cursor;\n"                                                       \
+	"%s\t\t}\n"                                                               \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tif (StateActions[state] != MAXACTIONS) mark();\n"                      \
+	"}\n"                                                                     \
+	"\n";
+
+// 0
+static const char *GLinesLoopRun =
+	"\n"                                                                      \
+	"\t\t\tconst unsigned char *end = run + len;\n"                           \
+	"\t\t\tconst unsigned char *nl;\n"                                        \
+	"\t\t\twhile ((nl = (const unsigned char *)memchr(run,\'\\n\',end - run)) != NULL) {\n" \
+	"\t\t\t\tcurColumn = 0;\n"                                                \
+	"\t\t\t\t++curLine;\n"                                                    \
+	"\t\t\t\trun = nl + 1;\n"                                                 \
+	"\t\t\t}\n"                                                               \
+	"\t\t\tcurColumn += (int32_t)(end - run);\n";
+
+// 0
+static const char *GLinesLoopByte =
+	"\n"                                                                      \
+	"\t\t\tif (ch == \'\\n\') {\n"                                            \
+	"\t\t\t\tcurColumn = 0;\n"                                                \
+	"\t\t\t\t++curLine;\n"                                                    \
+	"\t\t\t} else {\n"                                                        \
+	"\t\t\t\t++curColumn;\n"                                                  \
+	"\t\t\t}\n";
+
+// 7
+static const char *GLazySource =
+	"/*\n"                                                                    \
+	" *\tLazy DFA. The DFA for this lexer was too large to build in advance, so\n" \
+	" *\twe build its states from the NFA as they are reached. Each state is the\n" \
+	" *\tsorted list of NFA states it represents, along with a row of transitions\n" \
+	" *\twhich are filled in as they are used; after a while the states we need\n" \
+	" *\tare all cached and run at DFA speed. The cache holds at most MAXSTATES\n" \
+	" *\tstates. When it fills, it is flushed and we start again.\n"          \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::lazyInit(void)\n"                                               \
+	"{\n"                                                                     \
+	"\tlazyNext = (int32_t *)malloc(sizeof(int32_t) * MAXSTATES * MAXCHARCLASS);\n" \
+	"\tlazyRule = (uint32_t *)malloc(sizeof(uint32_t) * MAXSTATES);\n"        \
+	"\tlazySetStart = (uint32_t *)malloc(sizeof(uint32_t) * (MAXSTATES + 1));\n" \
+	"\tlazySets = (uint32_t *)malloc(sizeof(uint32_t) * LAZYPOOL);\n"         \
+	"\tlazyHash = (int32_t *)malloc(sizeof(int32_t) * LAZYHASH);\n"           \
+	"\tlazyMark = (uint32_t *)calloc(NFASTATES, sizeof(uint32_t));\n"         \
+	"\tlazyWork = (uint32_t *)malloc(sizeof(uint32_t) * NFASTATES);\n"        \
+	"\n"                                                                      \
+	"\tif (!lazyNext || !lazyRule || !lazySetStart || !lazySets ||\n"         \
+	"\t\t\t!lazyHash || !lazyMark || !lazyWork) {\n"                          \
+	"\t\tlazyFree();\n"                                                       \
+	"\t\tthrow std::bad_alloc();\n"                                           \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tlazyStamp = 0;\n"                                                      \
+	"\tlazyFlushes = 0;\n"                                                    \
+	"\tlazyFlush();\n"                                                        \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"void %s::lazyFree(void)\n"                                               \
+	"{\n"                                                                     \
+	"\tif (lazyNext) free(lazyNext);\n"                                       \
+	"\tif (lazyRule) free(lazyRule);\n"                                       \
+	"\tif (lazySetStart) free(lazySetStart);\n"                               \
+	"\tif (lazySets) free(lazySets);\n"                                       \
+	"\tif (lazyHash) free(lazyHash);\n"                                       \
+	"\tif (lazyMark) free(lazyMark);\n"                                       \
+	"\tif (lazyWork) free(lazyWork);\n"                                       \
+	"\n"                                                                      \
+	"\tlazyNext = NULL;\n"                                                    \
+	"\tlazyRule = NULL;\n"                                                    \
+	"\tlazySetStart = NULL;\n"                                                \
+	"\tlazySets = NULL;\n"                                                    \
+	"\tlazyHash = NULL;\n"                                                    \
+	"\tlazyMark = NULL;\n"                                                    \
+	"\tlazyWork = NULL;\n"                                                    \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tEmpty the cache. The start state is always state 0\n"                \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"void %s::lazyFlush(void)\n"                                              \
+	"{\n"                                                                     \
+	"\t++lazyFlushes;\n"                                                      \
+	"\tlazyCount = 0;\n"                                                      \
+	"\tlazySetStart[0] = 0;\n"                                                \
+	"\tfor (uint32_t i = 0; i < LAZYHASH; ++i) lazyHash[i] = -1;\n"           \
+	"\n"                                                                      \
+	"\tlazyState(LazyStart, LAZYSTARTSIZE);\n"                                \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tFind the state for the sorted set of NFA states, adding it to the\n" \
+	" *\tcache if it is not there.\n"                                         \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"uint32_t %s::lazyState(const uint32_t *set, uint32_t size)\n"            \
+	"{\n"                                                                     \
+	"\tuint32_t i,hash = 2166136261U;\n"                                      \
+	"\tfor (i = 0; i < size; ++i) {\n"                                        \
+	"\t\thash = (hash ^ set[i]) * 16777619U;\n"                               \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tuint32_t slot = hash & (LAZYHASH - 1);\n"                              \
+	"\tfor (;;) {\n"                                                          \
+	"\t\tint32_t s = lazyHash[slot];\n"                                       \
+	"\t\tif (s < 0) break;\n"                                                 \
+	"\n"                                                                      \
+	"\t\tuint32_t start = lazySetStart[s];\n"                                 \
+	"\t\tif ((lazySetStart[s+1] - start == size) &&\n"                        \
+	"\t\t\t\t!memcmp(lazySets + start, set, size * sizeof(uint32_t))) {\n"    \
+	"\t\t\treturn (uint32_t)s;\n"                                             \
+	"\t\t}\n"                                                                 \
+	"\t\tslot = (slot + 1) & (LAZYHASH - 1);\n"                               \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tNot found. If there is no room, flush the cache and try again\n"   \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tif ((lazyCount >= MAXSTATES) || (lazySetStart[lazyCount] + size > LAZYPOOL)) {\n" \
+	"\t\tlazyFlush();\n"                                                      \
+	"\t\treturn lazyState(set, size);\n"                                      \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tuint32_t s = lazyCount++;\n"                                           \
+	"\tuint32_t start = lazySetStart[s];\n"                                   \
+	"\tmemcpy(lazySets + start, set, size * sizeof(uint32_t));\n"             \
+	"\tlazySetStart[s+1] = start + size;\n"                                   \
+	"\tlazyHash[slot] = (int32_t)s;\n"                                        \
+	"\n"                                                                      \
+	"\tint32_t *next = lazyNext + s * MAXCHARCLASS;\n"                        \
+	"\tfor (i = 0; i < MAXCHARCLASS; ++i) next[i] = -1;\n"                    \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tThe action is the first rule ended by one of our NFA states whose\n" \
+	"\t *\tstart conditions hold. If that is unconditional we note it now;\n" \
+	"\t *\totherwise we mark the state to be checked as we run.\n"            \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tuint32_t rule = MAXACTIONS;\n"                                         \
+	"\tfor (i = 0; i < size; ++i) {\n"                                        \
+	"\t\tif (NFARule[set[i]] < rule) rule = NFARule[set[i]];\n"               \
+	"\t}\n"                                                                   \
+	"\tif ((rule < MAXACTIONS) && (RuleFlags[rule] || RuleStates[rule])) {\n" \
+	"\t\trule = MAXACTIONS + 1;\n"                                            \
+	"\t}\n"                                                                   \
+	"\tlazyRule[s] = rule;\n"                                                 \
+	"\n"                                                                      \
+	"\treturn (uint32_t)s;\n"                                                 \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tReturn the action for a state, checking the start conditions if\n"   \
+	" *\tthe state ends a conditional rule\n"                                 \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"uint32_t %s::lazyAction(uint32_t state)\n"                               \
+	"{\n"                                                                     \
+	"\tuint32_t rule = lazyRule[state];\n"                                    \
+	"\tif (rule <= MAXACTIONS) return rule;\n"                                \
+	"\n"                                                                      \
+	"\tuint32_t i,end = lazySetStart[state+1];\n"                             \
+	"\trule = MAXACTIONS;\n"                                                  \
+	"\tfor (i = lazySetStart[state]; i < end; ++i) {\n"                       \
+	"\t\tuint32_t r = NFARule[lazySets[i]];\n"                                \
+	"\t\tif ((r < rule) && lazyRuleMatches(r)) rule = r;\n"                   \
+	"\t}\n"                                                                   \
+	"\treturn rule;\n"                                                        \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"bool %s::lazyRuleMatches(uint32_t rule)\n"                               \
+	"{\n"                                                                     \
+	"\tif ((RuleFlags[rule] & 1) && !atSOL()) return false;\n"                \
+	"\tif ((RuleFlags[rule] & 2) && !atEOL()) return false;\n"                \
+	"\tif (RuleStates[rule] && !(RuleStates[rule] & states)) return false;\n" \
+	"\treturn true;\n"                                                        \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tRead the state for the class/state combination. If we haven\'t been\n" \
+	" *\there before, we find the NFA states we move to and their closure, and\n" \
+	" *\tlook up the state for that set. Returns MAXSTATES if there is no\n"  \
+	" *\ttransition.\n"                                                       \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"uint32_t %s::stateForClass(uint32_t charClass, uint32_t state)\n"        \
+	"{\n"                                                                     \
+	"\tif (charClass >= MAXCHARCLASS) return MAXSTATES;\n"                    \
+	"\n"                                                                      \
+	"\tint32_t *next = lazyNext + state * MAXCHARCLASS + charClass;\n"        \
+	"\tif (*next >= 0) return (uint32_t)*next;\n"                             \
+	"\n"                                                                      \
+	"\tif (++lazyStamp == 0) {\n"                                             \
+	"\t\tmemset(lazyMark, 0, sizeof(uint32_t) * NFASTATES);\n"                \
+	"\t\tlazyStamp = 1;\n"                                                    \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tuint32_t size = 0;\n"                                                  \
+	"\tuint32_t word = charClass >> 5;\n"                                     \
+	"\tuint32_t bit = 1U << (charClass & 31);\n"                              \
+	"\tuint32_t i,end = lazySetStart[state+1];\n"                             \
+	"\tfor (i = lazySetStart[state]; i < end; ++i) {\n"                       \
+	"\t\tuint32_t nfa = lazySets[i];\n"                                       \
+	"\t\tfor (uint32_t e = NFAEdgeStart[nfa]; e < NFAEdgeStart[nfa+1]; ++e) {\n" \
+	"\t\t\tif (!(NFASetClasses[NFAEdgeSet[e] * CLASSWORDS + word] & bit)) continue;\n" \
+	"\n"                                                                      \
+	"\t\t\tuint32_t t = NFAEdgeState[e];\n"                                   \
+	"\t\t\tfor (uint32_t c = NFAClosureStart[t]; c < NFAClosureStart[t+1]; ++c) {\n" \
+	"\t\t\t\tuint32_t n = NFAClosureList[c];\n"                               \
+	"\t\t\t\tif (lazyMark[n] != lazyStamp) {\n"                               \
+	"\t\t\t\t\tlazyMark[n] = lazyStamp;\n"                                    \
+	"\t\t\t\t\tlazyWork[size++] = n;\n"                                       \
+	"\t\t\t\t}\n"                                                             \
+	"\t\t\t}\n"                                                               \
+	"\t\t}\n"                                                                 \
+	"\t}\n"                                                                   \
+	"\n"                                                                      \
+	"\tif (size == 0) {\n"                                                    \
+	"\t\t*next = MAXSTATES;\n"                                                \
+	"\t\treturn MAXSTATES;\n"                                                 \
+	"\t}\n"                                                                   \
+	"\tstd::sort(lazyWork, lazyWork + size);\n"                               \
+	"\n"                                                                      \
+	"\t/*\n"                                                                  \
+	"\t *\tIf finding the state flushed the cache, our row is gone, so only\n" \
+	"\t *\tnote the transition if it did not.\n"                              \
+	"\t */\n"                                                                 \
+	"\n"                                                                      \
+	"\tuint32_t flushes = lazyFlushes;\n"                                     \
+	"\tuint32_t newState = lazyState(lazyWork, size);\n"                      \
+	"\tif (flushes == lazyFlushes) *next = newState;\n"                       \
+	"\n"                                                                      \
+	"\treturn newState;\n"                                                    \
+	"}\n"                                                                     \
+	"\n";
+
+
+/************************************************************************/
+/*																		*/
+/*	State writer														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexCPPGenerator::WriteArray
+ *
+ *		Write an array. This simply writes the list of items to an array,
+ *	and adds the size of the array, with elements width bytes wide, to
+ *	tableBytes.
+ */
+
+void OCLexCPPGenerator::WriteArray(FILE *f, uint32_t *list, size_t len, size_t width)
+{
+	size_t i = 0;
+
+	tableBytes += len * width;
+
+	for (i = 0; i < len; ++i) {
+		if (i) {
+			fprintf(f,", ");
+		}
+		if ((i % 8) == 0) {
+			if (i) fprintf(f,"\n");
+			fprintf(f,"    ");
+		}
+		fprintf(f,"%3u",list[i]);
+	}
+	fprintf(f,"\n");
+}
+
+/*	OCLexCPPGenerator::TypeWidth
+ *
+ *		The size of the narrowest unsigned type which holds max
+ */
+
+size_t OCLexCPPGenerator::TypeWidth(uint32_t max)
+{
+	if (max <= 0xFF) return sizeof(uint8_t);
+	if (max <= 0xFFFF) return sizeof(uint16_t);
+	return sizeof(uint32_t);
+}
+
+/*	OCLexCPPGenerator::WriteTable
+ *
+ *		Write a table as a static const array, using the narrowest unsigned
+ *	type which holds every value in the table unless a width is given. If
+ *	tableBlob is set, the table is written as a string instead.
+ */
+
+void OCLexCPPGenerator::WriteTable(FILE *f, const char *name, uint32_t *list, size_t len, size_t width)
+{
+	if (width == 0) {
+		uint32_t max = 0;
+		for (size_t i = 0; i < len; ++i) {
+			if (max < list[i]) max = list[i];
+		}
+		width = TypeWidth(max);
+	}
+
+	if (tableBlob) {
+		tableBytes += len * width;
+		blob.WriteTable(f,name,list,len,width);
+		return;
+	}
+
+	const char *type = (width == 1) ? "uint8_t" : ((width == 2) ? "uint16_t" : "uint32_t");
+
+	fprintf(f,"static const %s %s[%zu] = {\n",type,name,len);
+	WriteArray(f,list,len,width);
+	fprintf(f,"};\n\n");
+}
+
+/*	PairShift
+ *
+ *		The number of bits of a pair table entry which hold the state; the
+ *	action of the state between the two characters is stored above them.
+ *	There is room for MAXSTATES, which marks pairs we do not take.
+ */
+
+static uint32_t PairShift(size_t len)
+{
+	uint32_t shift = 1;
+	while (((size_t)1 << shift) <= len) ++shift;
+	return shift;
+}
+
+/*	OCLexCPPGenerator::ChooseFormat
+ *
+ *		Pick the table format. In auto mode we use a dense table if it fits
+ *	in our budget, as it needs no searching at all. The pair table is only
+ *	used if it fits in the budget along with the dense table it falls back
+ *	on; otherwise we pick as auto would.
+ */
+
+void OCLexCPPGenerator::ChooseFormat()
+{
+	if (lazyDFA) {
+		format = KTableCompressed;
+		return;
+	}
+
+	size_t len = dfaStates.size();
+	size_t width = charClasses.size() + 1;
+	size_t dense = len * width * TypeWidth((uint32_t)len);
+	uint32_t pairMax = ((uint32_t)codeRules.size() << PairShift(len)) | (uint32_t)len;
+	size_t pair = len * width * width * TypeWidth(pairMax);
+
+	format = tableFormat;
+	if ((format == KTablePair) && (dense + pair > tableBudget)) {
+		format = KTableAuto;
+	}
+	if (format == KTableAuto) {
+		format = (dense <= tableBudget) ? KTableDense : KTableCompressed;
+	}
+}
+
+/*	WriteClassList
+ *
+ *		Write the character classes as a comment. A class which is a lone
+ *	backslash is written as [\\], as a line ending in a backslash would
+ *	run the comment on into the next line.
+ */
+
+static void WriteClassList(FILE *f, const std::vector<OCCharSet> &classes)
+{
+	fprintf(f,"\n");
+	fprintf(f,"//  Character classes used during parsing:\n");
+	fprintf(f,"//\n");
+	for (size_t i = 0; i < classes.size(); ++i) {
+		std::string str = classes[i].ToString();
+		if (str == "\\") str = "[\\\\]";
+		fprintf(f,"//  %zu: %s\n",i,str.c_str());
+	}
+	fprintf(f,"\n");
+}
+
+/*	OCLexCPPGenerator::WriteStates
+ *
+ *		Write the states
+ */
+
+void OCLexCPPGenerator::WriteStates(FILE *f)
+{
+	ChooseFormat();
+	if (lazyDFA) {
+		WriteLazyStates(f);
+		return;
+	}
+
+	if (verbose) {
+		static const char *names[] = { "auto", "compressed", "dense", "byte", "code", "pair" };
+		printf("Table format: %s\n",names[format]);
+	}
+
+	/*
+	 *	Print the state sizes
+	 */
+
+	fprintf(f,"/************************************************************************/\n");
+	fprintf(f,"/*                                                                      */\n");
+	fprintf(f,"/*  Lex Transition State Tables                                         */\n");
+	fprintf(f,"/*                                                                      */\n");
+	fprintf(f,"/************************************************************************/\n");
+
+	/*
+	 *	Constants
+	 */
+
+	fprintf(f,"\n");
+	fprintf(f,"/*\n");
+	fprintf(f," *  Constants\n");
+	fprintf(f," */\n\n");
+
+	fprintf(f,"#define MAXSTATES       %lu\n",dfaStates.size());
+	fprintf(f,"#define MAXCHARCLASS    %lu\n",charClasses.size());
+	fprintf(f,"#define MAXACTIONS      %lu\n\n",codeRules.size());
+
+	/*
+	 *	Code has no tables; the states are written in lex() by WriteCodeDFA
+	 */
+
+	if (format == KTableCode) return;
+
+	/*
+	 *	Generate the character class list.
+	 */
+
+	uint32_t carray[256];
+	size_t i,len = charClasses.size();
+	for (i = 0; i < 256; ++i) carray[i] = (uint32_t)len;
+	for (i = 0; i < len; ++i) {
+		const OCCharSet &set = charClasses[i];
+		for (int j = 0; j < 256; ++j) {
+			if (set.TestCharacter((unsigned char)j)) {
+				carray[j] = (uint32_t)i;
+			}
+		}
+	}
+
+	WriteClassList(f,charClasses);
+
+	if (format != KTableByte) {
+		fprintf(f,"/*  CharClass\n");
+		fprintf(f," *\n");
+		fprintf(f," *      Maps 8-bit character to character class\n");
+		fprintf(f," */\n\n");
+		WriteTable(f,"CharClass",carray,256);
+	}
+
+	/*
+	 *	Generate state actions. This is a table which maps from a state
+	 *	index to an action index. Note if this DFA state has no rule, we
+	 *	land on MAXACTION. If the DFA has a conditional rule, we go to
+	 *	an index greater than MAXACTION.
+	 */
+
+	fprintf(f,"/*  StateActions\n");
+	fprintf(f," *\n");
+	fprintf(f," *      Maps states to actions. MAXACTION if this is not a terminal\n");
+	fprintf(f," */\n\n");
+
+	size_t alen = codeRules.size();
+	uint32_t swindex = (uint32_t)alen;
+	len = dfaStates.size();
+	uint32_t *scratch = (uint32_t *)malloc(len * sizeof(uint32_t));
+	for (i = 0; i < len; ++i) {
+		OCLexDFAState &state = dfaStates[i];
+
+		if (state.endList.size() == 0) {
+			scratch[i] = (uint32_t)alen;
+		} else if ((state.endList.size() == 1) &&
+				   (state.endList[0].startState.unconditional())) {
+			scratch[i] = state.endList[0].endRule;
+		} else {
+			scratch[i] = ++swindex;
+		}
+	}
+
+	WriteTable(f,"StateActions",scratch,len);
+	free(scratch);
+
+	/*
+	 *	Generate the DFA state transitions
+	 */
+
+	size_t clen = charClasses.size();
+	size_t tlen = len * clen;
+	scratch = (uint32_t *)malloc(tlen * sizeof(uint32_t));
+
+	size_t ptr = 0;
+	for (i = 0; i < len; ++i) {
+		OCLexDFAState &state = dfaStates[i];
+		for (size_t j = 0; j < clen; ++j) {
+			OCCharSet &cset = charClasses[j];
+
+			/*
+			 *	Find the transition which intersects
+			 */
+
+			uint32_t newState = (uint32_t)len;
+
+			std::vector<OCLexDFATransition>::iterator t;
+			for (t = state.list.begin(); t != state.list.end(); ++t) {
+				if (t->set.Contains(cset)) {
+					// This transition contains our cset. Set and move on
+					newState = (uint32_t)t->state;
+					break;
+				}
+			}
+
+			scratch[ptr++] = newState;
+		}
+	}
+
+	if (format == KTableDense) {
+		/*
+		 *	Dense table, with an extra column for characters in no class
+		 */
+
+		size_t width = clen + 1;
+		uint32_t *dense = (uint32_t *)malloc(len * width * sizeof(uint32_t));
+		for (i = 0; i < len; ++i) {
+			memcpy(dense + i * width,scratch + i * clen,clen * sizeof(uint32_t));
+			dense[i * width + clen] = (uint32_t)len;
+		}
+
+		fprintf(f,"/*  StateMachine\n");
+		fprintf(f," *\n");
+		fprintf(f," *      Lex state machine, indexed by state * (MAXCHARCLASS + 1) + class.\n");
+		fprintf(f," *  MAXSTATES if there is no transition.\n");
+		fprintf(f," */\n\n");
+		WriteTable(f,"StateMachine",dense,len * width);
+
+		free(dense);
+		free(scratch);
+		return;
+	}
+
+	if (format == KTablePair) {
+		/*
+		 *	Dense table, and the pair table: the state reached by two
+		 *	characters at once, with the action of the state between the
+		 *	two above it, so the lexer need not look that state up. The
+		 *	lexer can't check start conditions there, so we leave out pairs
+		 *	whose first step lands on a state which ends a conditional rule.
+		 */
+
+		size_t width = clen + 1;
+		uint32_t *dense = (uint32_t *)malloc(len * width * sizeof(uint32_t));
+		for (i = 0; i < len; ++i) {
+			memcpy(dense + i * width,scratch + i * clen,clen * sizeof(uint32_t));
+			dense[i * width + clen] = (uint32_t)len;
+		}
+
+		uint32_t shift = PairShift(len);
+		uint32_t *pairs = (uint32_t *)malloc(len * width * width * sizeof(uint32_t));
+		for (i = 0; i < len * width * width; ++i) pairs[i] = (uint32_t)len;
+		for (i = 0; i < len; ++i) {
+			for (size_t a = 0; a < clen; ++a) {
+				uint32_t mid = scratch[i * clen + a];
+				if (mid == len) continue;
+
+				const std::vector<OCLexDFAEnd> &endList = dfaStates[mid].endList;
+				if ((endList.size() > 1) ||
+						((endList.size() == 1) && !endList[0].startState.unconditional())) {
+					continue;
+				}
+
+				uint32_t action = endList.empty() ? (uint32_t)alen : endList[0].endRule;
+				uint32_t *row = pairs + (i * width + a) * width;
+				for (size_t b = 0; b < width; ++b) {
+					uint32_t next = dense[mid * width + b];
+					if (next != len) row[b] = (action << shift) | next;
+				}
+			}
+		}
+
+		fprintf(f,"/*  StateMachine\n");
+		fprintf(f," *\n");
+		fprintf(f," *      Lex state machine, indexed by state * (MAXCHARCLASS + 1) + class.\n");
+		fprintf(f," *  MAXSTATES if there is no transition.\n");
+		fprintf(f," */\n\n");
+		WriteTable(f,"StateMachine",dense,len * width);
+
+		fprintf(f,"#define PAIRSHIFT       %u\n",shift);
+		fprintf(f,"#define PAIRSTATE       ((1U << PAIRSHIFT) - 1)\n\n");
+
+		fprintf(f,"/*  PairMachine\n");
+		fprintf(f," *\n");
+		fprintf(f," *      Lex state machine for two characters at once, indexed by\n");
+		fprintf(f," *  (state * (MAXCHARCLASS + 1) + class) * (MAXCHARCLASS + 1) + class.\n");
+		fprintf(f," *  The low PAIRSHIFT bits are the state, and the bits above are the\n");
+		fprintf(f," *  action of the state after the first character. MAXSTATES if the\n");
+		fprintf(f," *  pair must be taken one character at a time.\n");
+		fprintf(f," */\n\n");
+		WriteTable(f,"PairMachine",pairs,len * width * width);
+
+		free(pairs);
+		free(dense);
+		free(scratch);
+		return;
+	}
+
+	if (format == KTableByte) {
+		/*
+		 *	Byte table: fold the character class lookup into the table
+		 */
+
+		uint32_t *bytes = (uint32_t *)malloc(len * 256 * sizeof(uint32_t));
+		for (i = 0; i < len; ++i) {
+			for (size_t j = 0; j < 256; ++j) {
+				uint32_t c = carray[j];
+				bytes[i * 256 + j] = (c < clen) ? scratch[i * clen + c] : (uint32_t)len;
+			}
+		}
+
+		fprintf(f,"/*  StateMachine\n");
+		fprintf(f," *\n");
+		fprintf(f," *      Lex state machine, indexed by state * 256 + character. MAXSTATES\n");
+		fprintf(f," *  if there is no transition.\n");
+		fprintf(f," */\n\n");
+		WriteTable(f,"StateMachine",bytes,len * 256);
+
+		free(bytes);
+		free(scratch);
+		return;
+	}
+
+	fprintf(f,"/*  StateMachineBase, StateMachineNext, StateMachineCheck\n");
+	fprintf(f," *\n");
+	        // 01234567890123456789012345678901234567890123456789012345678901234567890123456789
+	fprintf(f," *      Lex state machine compressed by row displacement. The rows of the\n");
+	fprintf(f," *  state machine are overlaid in StateMachineNext, each starting at its own\n");
+	fprintf(f," *  base, so the transition for a state and character class is at index\n");
+	fprintf(f," *  StateMachineBase[state] + class. StateMachineCheck holds the base of the\n");
+	fprintf(f," *  row which owns each entry; if it is not ours there is no transition.\n");
+	fprintf(f," *  States with the same transitions share a row.\n");
+	fprintf(f," */\n\n");
+
+	OCCombStates comb(clen,len,scratch,(uint32_t)len);
+
+	WriteTable(f,"StateMachineBase",comb.base,comb.bsize);
+	WriteTable(f,"StateMachineNext",comb.next,comb.size);
+	WriteTable(f,"StateMachineCheck",comb.check,comb.size);
+
+	free(scratch);
+}
+
+/*	LoopRanges
+ *
+ *		Find the ranges of characters in the set, or outside it if invert
+ *	is set, for the generated lexer to test. Returns false if there are
+ *	more than four.
+ */
+
+static bool LoopRanges(const uint8_t *set, bool invert, uint8_t *range)
+{
+	int count = 0;
+	int ch = 0;
+	while (ch < 256) {
+		bool in = (0 != (set[ch >> 3] & (1 << (ch & 7))));
+		if (in == invert) {
+			++ch;
+			continue;
+		}
+
+		int lo = ch;
+		while ((ch < 256) && (invert != (0 != (set[ch >> 3] & (1 << (ch & 7)))))) ++ch;
+		if (count == 4) return false;
+
+		range[count * 2] = (uint8_t)lo;
+		range[count * 2 + 1] = (uint8_t)(ch - 1 - lo);
+		++count;
+	}
+	if (count == 0) return false;
+
+	for (int i = count; i < 4; ++i) {
+		range[i * 2] = range[0];
+		range[i * 2 + 1] = range[1];
+	}
+	range[8] = invert ? 1 : 0;
+	return true;
+}
+
+/*	OCLexCPPGenerator::FindLoops
+ *
+ *		Find the states which loop back to themselves, for the formats
+ *	which use the table driven lexer. We leave out states with conditional
+ *	rules, as their action can change from one character to the next, and
+ *	sets which take more than four ranges to test.
+ */
+
+void OCLexCPPGenerator::FindLoops(std::vector<Loop> &loops)
+{
+	loops.clear();
+	if (lazyDFA || (format == KTableCode) || (format == KTablePair)) return;
+
+	uint32_t i,len = (uint32_t)dfaStates.size();
+	for (i = 0; i < len; ++i) {
+		OCLexDFAState &state = dfaStates[i];
+
+		const std::vector<OCLexDFAEnd> &endList = state.endList;
+		if ((endList.size() > 1) ||
+				((endList.size() == 1) && !endList[0].startState.unconditional())) {
+			continue;
+		}
+
+		Loop l;
+		memset(&l,0,sizeof(l));
+		l.state = i;
+
+		bool found = false;
+		std::vector<OCLexDFATransition>::iterator t;
+		for (t = state.list.begin(); t != state.list.end(); ++t) {
+			if (t->state != i) continue;
+
+			found = true;
+			for (int ch = 0; ch < 256; ++ch) {
+				if (t->set.TestCharacter((unsigned char)ch)) {
+					l.set[ch >> 3] |= (uint8_t)(1 << (ch & 7));
+				}
+			}
+		}
+		if (!found) continue;
+
+		if (!LoopRanges(l.set,false,l.range) && !LoopRanges(l.set,true,l.range)) {
+			continue;
+		}
+		loops.push_back(l);
+	}
+}
+
+/*	OCLexCPPGenerator::WriteLoopStates
+ *
+ *		Write the tables for the states which loop back to themselves: the
+ *	loop for each state, and the set of characters for each loop, both as
+ *	a bitmap and as ranges.
+ */
+
+void OCLexCPPGenerator::WriteLoopStates(FILE *f, const std::vector<Loop> &loops)
+{
+	size_t i,len = dfaStates.size();
+	size_t llen = loops.size();
+
+	fprintf(f,"#define MAXLOOPS        %zu\n\n",llen);
+
+	uint32_t *scratch = (uint32_t *)malloc(len * sizeof(uint32_t));
+	for (i = 0; i < len; ++i) scratch[i] = (uint32_t)llen;
+	for (i = 0; i < llen; ++i) scratch[loops[i].state] = (uint32_t)i;
+
+	fprintf(f,"/*  StateLoop\n");
+	fprintf(f," *\n");
+	fprintf(f," *      Maps states to the loop back to the same state, or MAXLOOPS\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"StateLoop",scratch,len);
+	free(scratch);
+
+	scratch = (uint32_t *)malloc(llen * 32 * sizeof(uint32_t));
+	for (i = 0; i < llen; ++i) {
+		for (size_t j = 0; j < 32; ++j) scratch[i * 32 + j] = loops[i].set[j];
+	}
+
+	fprintf(f,"/*  LoopSet\n");
+	fprintf(f," *\n");
+	fprintf(f," *      The characters for each loop, as 32 bytes of bits\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"LoopSet",scratch,llen * 32);
+	free(scratch);
+
+	scratch = (uint32_t *)malloc(llen * 9 * sizeof(uint32_t));
+	for (i = 0; i < llen; ++i) {
+		for (size_t j = 0; j < 9; ++j) scratch[i * 9 + j] = loops[i].range[j];
+	}
 
-static const char *GSource6 =
-	"\t\t\tdefault:\n"                                                        \
-	"\t\t\t\tbreak;\n"                                                        \
-	"\t\t}\n"                                                                 \
-	"\t}\n"                                                                   \
-	"}\n"                                                                     \
-	"\n";
+	fprintf(f,"/*  LoopRange\n");
+	fprintf(f," *\n");
+	fprintf(f," *      The characters for each loop, as four ranges of characters\n");
+	fprintf(f," *  given by the first and the count past it, then 1 if the loop is the\n");
+	fprintf(f," *  characters outside the ranges\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"LoopRange",scratch,llen * 9);
+	free(scratch);
+}
 
+/*	OCLexCPPGenerator::FindStops
+ *
+ *		Find the states with no moves out. A token which reaches one of
+ *	these ends there, so the lexer stops without reading another character.
+ *	The pair and lazy lexers do not stop early.
+ */
 
-/************************************************************************/
-/*																		*/
-/*	State writer														*/
-/*																		*/
-/************************************************************************/
+void OCLexCPPGenerator::FindStops(std::vector<uint8_t> &stops)
+{
+	stops.clear();
+	if (lazyDFA || (format == KTablePair)) return;
 
-/*	OCLexCPPGenerator::WriteArray
+	uint32_t i,len = (uint32_t)dfaStates.size();
+	stops.resize(len,0);
+	for (i = 0; i < len; ++i) {
+		if (dfaStates[i].list.empty()) stops[i] = 1;
+	}
+}
+
+/*	AlwaysAccepts
  *
- *		Write an array. This simply writes the list of items to an array
+ *		True if the state has an action whatever the start conditions
  */
 
-void OCLexCPPGenerator::WriteArray(FILE *f, uint32_t *list, size_t len)
+static bool AlwaysAccepts(const OCLexDFAState &state)
 {
-	size_t i = 0;
+	return (state.endList.size() == 1) && state.endList[0].startState.unconditional();
+}
+
+/*	OCLexCPPGenerator::ReportBackup
+ *
+ *		Print the backing up report, in the way flex does. If an accepting
+ *	state can move to a state which may not accept, the lexer may have to
+ *	back up past the characters read after it; for each we print the
+ *	characters which do so. If every move is to a state which always
+ *	accepts, the lexer reads at most one character too many, and if there
+ *	are no moves at all the token ends there. Only the last is used by the
+ *	lexer (see FindStops); backing up itself only moves the cursor back.
+ */
+
+void OCLexCPPGenerator::ReportBackup()
+{
+	uint32_t i,len = (uint32_t)dfaStates.size();
+	uint32_t backup = 0,accept = 0,stop = 0;
+	std::vector<OCLexDFATransition>::iterator t;
 
 	for (i = 0; i < len; ++i) {
-		if (i) {
-			fprintf(f,", ");
+		OCLexDFAState &state = dfaStates[i];
+		if (state.endList.size() == 0) continue;
+
+		if (state.list.empty()) {
+			++stop;
+			continue;
 		}
-		if ((i % 8) == 0) {
-			if (i) fprintf(f,"\n");
-			fprintf(f,"    ");
+
+		OCCharSet set;
+		for (t = state.list.begin(); t != state.list.end(); ++t) {
+			if (!AlwaysAccepts(dfaStates[t->state])) set |= t->set;
+		}
+		if (set.IsEmpty()) {
+			++accept;
+		} else {
+			++backup;
+		}
+	}
+	printf("Backing up: %u accepting states may back up, %u cannot, %u stop\n",
+		   backup,accept,stop);
+
+	for (i = 0; i < len; ++i) {
+		OCLexDFAState &state = dfaStates[i];
+		if ((state.endList.size() == 0) || state.list.empty()) continue;
+
+		OCCharSet set;
+		for (t = state.list.begin(); t != state.list.end(); ++t) {
+			if (!AlwaysAccepts(dfaStates[t->state])) set |= t->set;
+		}
+		if (!set.IsEmpty()) {
+			printf("    State %u backs up on %s\n",i,set.ToString().c_str());
 		}
-		fprintf(f,"%3d",list[i]);
 	}
-	fprintf(f,"\n");
 }
 
-/*	OCLexCPPGenerator::WriteStates
+/*	OCLexCPPGenerator::WriteStopStates
  *
- *		Write the states
+ *		Write the table of which states end the token, for the table driven
+ *	lexer.
  */
 
-void OCLexCPPGenerator::WriteStates(FILE *f)
+void OCLexCPPGenerator::WriteStopStates(FILE *f, const std::vector<uint8_t> &stops)
+{
+	size_t i,len = stops.size();
+
+	uint32_t *scratch = (uint32_t *)malloc(len * sizeof(uint32_t));
+	for (i = 0; i < len; ++i) scratch[i] = stops[i];
+
+	fprintf(f,"/*  StateStop\n");
+	fprintf(f," *\n");
+	fprintf(f," *      1 if the state has no moves out, so the token ends there\n");
+	fprintf(f," *  without reading another character\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"StateStop",scratch,len);
+	free(scratch);
+}
+
+/*	OCLexCPPGenerator::WriteLazyStates
+ *
+ *		Write the tables for a lazy DFA. When the DFA went over its state
+ *	budget we write the NFA instead, and the lexer builds the DFA states
+ *	it needs as it runs. This writes the character classes, the transitions
+ *	of each NFA state along with the classes each transition covers, the
+ *	precomputed closure of each NFA state, and the start conditions of each
+ *	rule.
+ */
+
+void OCLexCPPGenerator::WriteLazyStates(FILE *f)
 {
+	size_t i,len;
+	uint32_t nfaLen = StateCount();
+	size_t clen = charClasses.size();
+	size_t alen = codeRules.size();
+	size_t cwords = (clen + 31) / 32;
+
 	/*
-	 *	Print the state sizes
+	 *	The cache holds up to the state budget, but no more than 2^24 states
+	 *	so offsets into the set storage fit in 32 bits. A flush leaves the
+	 *	start state, so the cache needs room for at least one more, and the
+	 *	set storage always has room for at least two sets of NFA states, so
+	 *	we can always add a state after a flush.
+	 */
+
+	uint32_t cacheStates = maxStates;
+	if (cacheStates < 2) cacheStates = 2;
+	if (cacheStates > 0x1000000) cacheStates = 0x1000000;
+
+	uint32_t hashSize = 1;
+	while (hashSize < cacheStates * 2) hashSize <<= 1;
+
+	/*
+	 *	The start state is the closure of our start states
 	 */
 
+	std::set<uint32_t> start;
+	for (i = 0; i < startStates.size(); ++i) {
+		uint32_t s = startStates[i];
+		start.insert(closureList.begin() + closureStart[s],closureList.begin() + closureStart[s+1]);
+	}
+
 	fprintf(f,"/************************************************************************/\n");
 	fprintf(f,"/*                                                                      */\n");
-	fprintf(f,"/*  Lex Transition State Tables                                         */\n");
+	fprintf(f,"/*  Lex NFA Tables                                                      */\n");
 	fprintf(f,"/*                                                                      */\n");
 	fprintf(f,"/************************************************************************/\n");
 
-	/*
-	 *	Constants
-	 */
-
 	fprintf(f,"\n");
 	fprintf(f,"/*\n");
-	fprintf(f," *  Constants\n");
+	fprintf(f," *  Constants. MAXSTATES is the size of the lazy DFA cache\n");
 	fprintf(f," */\n\n");
 
-	fprintf(f,"#define MAXSTATES       %lu\n",dfaStates.size());
-	fprintf(f,"#define MAXCHARCLASS    %lu\n",charClasses.size());
-	fprintf(f,"#define MAXACTIONS      %lu\n\n",codeRules.size());
+	fprintf(f,"#define MAXSTATES       %u\n",cacheStates);
+	fprintf(f,"#define MAXCHARCLASS    %zu\n",clen);
+	fprintf(f,"#define MAXACTIONS      %zu\n",alen);
+	fprintf(f,"#define NFASTATES       %u\n",nfaLen);
+	fprintf(f,"#define CLASSWORDS      %zu\n",cwords);
+	fprintf(f,"#define LAZYPOOL        %lu\n",(unsigned long)cacheStates * 8 + nfaLen * 2);
+	fprintf(f,"#define LAZYHASH        %u\n",hashSize);
+	fprintf(f,"#define LAZYSTARTSIZE   %zu\n\n",start.size());
 
 	/*
-	 *	Generate the character class list.
+	 *	Character classes
 	 */
 
 	uint32_t carray[256];
-	size_t i,len = charClasses.size();
-	for (i = 0; i < 256; ++i) carray[i] = (uint16_t)len;
-	for (i = 0; i < len; ++i) {
-		const OCCharSet &set = charClasses[i];
+	for (i = 0; i < 256; ++i) carray[i] = (uint32_t)clen;
+	for (i = 0; i < clen; ++i) {
 		for (int j = 0; j < 256; ++j) {
-			if (set.TestCharacter((unsigned char)j)) {
+			if (charClasses[i].TestCharacter((unsigned char)j)) {
 				carray[j] = (uint32_t)i;
 			}
 		}
 	}
 
-	fprintf(f,"\n");
-	fprintf(f,"//  Character classes used during parsing:\n");
-	fprintf(f,"//\n");
-	for (i = 0; i < len; ++i) {
-		const OCCharSet &cset = charClasses[i];
-		fprintf(f,"//  %zu: %s\n",i,cset.ToString().c_str());
-	}
-	fprintf(f,"\n");
+	WriteClassList(f,charClasses);
 
 	fprintf(f,"/*  CharClass\n");
 	fprintf(f," *\n");
 	fprintf(f," *      Maps 8-bit character to character class\n");
 	fprintf(f," */\n\n");
-	fprintf(f,"static uint16_t CharClass[256] = {\n");
-	WriteArray(f, carray, 256);
-	fprintf(f,"};\n\n");
+	WriteTable(f,"CharClass",carray,256);
 
 	/*
-	 *	Generate state actions. This is a table which maps from a state
-	 *	index to an action index. Note if this DFA state has no rule, we
-	 *	land on MAXACTION. If the DFA has a conditional rule, we go to
-	 *	an index greater than MAXACTION.
+	 *	NFA states: the rule each ends, and the transitions out of each in
+	 *	compressed sparse row form.
 	 */
 
-	fprintf(f,"/*  StateActions\n");
+	std::vector<uint32_t> rules(nfaLen);
+	std::vector<uint32_t> edgeStart(nfaLen + 1);
+	std::vector<uint32_t> edgeState;
+	std::vector<uint32_t> edgeSet;
+	for (i = 0; i < nfaLen; ++i) {
+		rules[i] = (endRule[i] == NFA_NOEND) ? (uint32_t)alen : endRule[i];
+
+		edgeStart[i] = (uint32_t)edgeState.size();
+		for (OCLexNFAEdge *edge = charEdges[i]; edge; edge = edge->next) {
+			edgeState.push_back(edge->state);
+			edgeSet.push_back(edge->set);
+		}
+	}
+	edgeStart[nfaLen] = (uint32_t)edgeState.size();
+
+	std::vector<uint32_t> setClasses(charSets.size() * cwords, 0);
+	for (i = 0; i < charSets.size(); ++i) {
+		std::vector<uint16_t>::iterator c;
+		for (c = classLists[i].begin(); c != classLists[i].end(); ++c) {
+			setClasses[i * cwords + (*c >> 5)] |= 1U << (*c & 31);
+		}
+	}
+
+	fprintf(f,"/*  NFARule\n");
 	fprintf(f," *\n");
-	fprintf(f," *      Maps states to actions. MAXACTION if this is not a terminal\n");
+	fprintf(f," *      Maps NFA states to the rule they end, or MAXACTIONS\n");
 	fprintf(f," */\n\n");
+	WriteTable(f,"NFARule",rules.data(),nfaLen);
 
-	size_t alen = codeRules.size();
-	uint32_t swindex = (uint32_t)alen;
-	len = dfaStates.size();
-	uint32_t *scratch = (uint32_t *)malloc(len * sizeof(uint32_t));
-	for (i = 0; i < len; ++i) {
-		OCLexDFAState &state = dfaStates[i];
+	fprintf(f,"/*  NFAEdgeStart, NFAEdgeState, NFAEdgeSet\n");
+	fprintf(f," *\n");
+	fprintf(f," *      The transitions out of NFA state i are NFAEdgeStart[i] up to\n");
+	fprintf(f," *  NFAEdgeStart[i+1]. Each goes to NFAEdgeState on the classes in\n");
+	fprintf(f," *  the bitmap at NFASetClasses[NFAEdgeSet * CLASSWORDS].\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"NFAEdgeStart",edgeStart.data(),nfaLen + 1);
 
-		if (state.endList.size() == 0) {
-			scratch[i] = (uint32_t)alen;
-		} else if ((state.endList.size() == 1) &&
-				   (state.endList[0].startState.unconditional())) {
-			scratch[i] = state.endList[0].endRule;
-		} else {
-			scratch[i] = ++swindex;
-		}
+	len = edgeState.size();
+	if (len == 0) {
+		edgeState.push_back(0);
+		edgeSet.push_back(0);
 	}
+	WriteTable(f,"NFAEdgeState",edgeState.data(),edgeState.size());
+
+	WriteTable(f,"NFAEdgeSet",edgeSet.data(),edgeSet.size());
+
+	if (setClasses.empty()) setClasses.push_back(0);
+	WriteTable(f,"NFASetClasses",setClasses.data(),setClasses.size());
+
+	/*
+	 *	Closures, and the start state
+	 */
+
+	fprintf(f,"/*  NFAClosureStart, NFAClosureList\n");
+	fprintf(f," *\n");
+	fprintf(f," *      The e-closure of NFA state i is NFAClosureList from\n");
+	fprintf(f," *  NFAClosureStart[i] up to NFAClosureStart[i+1].\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"NFAClosureStart",closureStart.data(),nfaLen + 1);
+
+	WriteTable(f,"NFAClosureList",closureList.data(),closureList.size());
 
-	fprintf(f,"static uint16_t StateActions[%zu] = {\n",len);
-	WriteArray(f,scratch,len);
+	// lazyState() takes a pointer to the start set, so it stays an array
+	std::vector<uint32_t> startList(start.begin(),start.end());
+	fprintf(f,"static const uint32_t LazyStart[%zu] = {\n",startList.size());
+	WriteArray(f,startList.data(),startList.size(),sizeof(uint32_t));
 	fprintf(f,"};\n\n");
-	free(scratch);
 
 	/*
-	 *	Generate the DFA state transitions
+	 *	Start conditions for each rule. RuleFlags is 1 if the rule must
+	 *	start a line and 2 if it must end one; RuleStates is the mask of
+	 *	the start states it runs in, or 0 for all.
 	 */
 
-	size_t clen = charClasses.size();
-	size_t tlen = len * clen;
-	scratch = (uint32_t *)malloc(tlen * sizeof(uint32_t));
+	std::vector<uint32_t> flags(alen + 1,0);
+	std::vector<uint32_t> masks(alen + 1,0);
+	for (i = 0; i < alen; ++i) {
+		const OCStartState &start = codeRules[i].start;
+		if (start.startFlag()) flags[i] |= 1;
+		if (start.endFlag()) flags[i] |= 2;
+		masks[i] = start.stateFlags(ruleStates);
+	}
+
+	fprintf(f,"/*  RuleFlags, RuleStates\n");
+	fprintf(f," *\n");
+	fprintf(f," *      The start conditions of each rule. RuleFlags is 1 if the rule\n");
+	fprintf(f," *  must start a line and 2 if it must end one; RuleStates is the mask\n");
+	fprintf(f," *  of start states it applies to, or 0 for all of them.\n");
+	fprintf(f," */\n\n");
+	WriteTable(f,"RuleFlags",flags.data(),alen + 1);
+
+	WriteTable(f,"RuleStates",masks.data(),alen + 1);
+}
+
+/************************************************************************/
+/*																		*/
+/*	Direct-Coded DFA													*/
+/*																		*/
+/************************************************************************/
+
+/*	CodeChar
+ *
+ *		Format a character for a case label or a comparison
+ */
+
+static std::string CodeChar(uint32_t ch)
+{
+	char buffer[8];
+
+	if ((ch > ' ') && (ch < 127) && (ch != '\'') && (ch != '\\')) {
+		snprintf(buffer,sizeof(buffer),"'%c'",(char)ch);
+	} else {
+		snprintf(buffer,sizeof(buffer),"%u",ch);
+	}
+	return buffer;
+}
+
+/*	CodeLabel
+ *
+ *		The label for a state. A transition to len, the number of states,
+ *	is no transition at all.
+ */
+
+static std::string CodeLabel(uint32_t state, uint32_t len)
+{
+	char buffer[32];
+
+	if (state >= len) return "lexDone";
+	snprintf(buffer,sizeof(buffer),"lexEnter%u",state);
+	return buffer;
+}
+
+/*	OCLexCPPGenerator::WriteCodeDFA
+ *
+ *		Write the DFA as code, in the body of lex(). Each state we can move
+ *	to has a label, lexEnterN, which notes the action for the state, then
+ *	reads the next character and jumps to the next state. This is the
+ *	approach taken by re2c; there are no table reads, and each state's
+ *	branches are predicted separately.
+ *
+ *		Characters are tested as ranges. A state with only a few ranges is
+ *	written as a binary search on them, and others as a switch, which the
+ *	compiler can turn into a jump table.
+ */
+
+void OCLexCPPGenerator::WriteCodeDFA(FILE *f, const std::vector<uint8_t> &stops)
+{
+	uint32_t i,len = (uint32_t)dfaStates.size();
+	uint32_t swindex = (uint32_t)codeRules.size();
+
+	/*
+	 *	The transition for each state and character, and the states which
+	 *	are moved to, which are the ones that need a label.
+	 */
+
+	std::vector<uint32_t> next((size_t)len * 256,len);
+	std::vector<bool> entered(len,false);
+	for (i = 0; i < len; ++i) {
+		uint32_t *row = next.data() + (size_t)i * 256;
+
+		std::vector<OCLexDFATransition>::iterator t;
+		for (t = dfaStates[i].list.begin(); t != dfaStates[i].list.end(); ++t) {
+			for (uint32_t c = 0; c < 256; ++c) {
+				if ((row[c] == len) && t->set.TestCharacter((unsigned char)c)) {
+					row[c] = (uint32_t)t->state;
+				}
+			}
+			entered[t->state] = true;
+		}
+	}
 
-	size_t ptr = 0;
 	for (i = 0; i < len; ++i) {
 		OCLexDFAState &state = dfaStates[i];
-		for (size_t j = 0; j < clen; ++j) {
-			OCCharSet &cset = charClasses[j];
+		uint32_t *row = next.data() + (size_t)i * 256;
+
+		/*
+		 *	Entering the state. The start state is entered at the top of
+		 *	lex(), so if we can also move to it we jump past its entry.
+		 */
+
+		bool conditional = (state.endList.size() > 1) ||
+				((state.endList.size() == 1) && !state.endList[0].startState.unconditional());
+		if (conditional) ++swindex;
+
+		if (entered[i]) {
+			if (i == 0) fprintf(f,"\t\tgoto lexScan0;\n\n");
+
+			fprintf(f,"\tlexEnter%u:\n",i);
+
+			if (conditional) {
+				fprintf(f,"\t\t{\n");
+				fprintf(f,"\t\t\tuint32_t newAction = conditionalAction(%u);\n",swindex);
+				fprintf(f,"\t\t\tif (newAction != MAXACTIONS) {\n");
+				fprintf(f,"\t\t\t\taction = newAction;\n");
+				fprintf(f,"\t\t\t\tmark();\n");
+				fprintf(f,"\t\t\t}\n");
+				fprintf(f,"\t\t}\n");
+			} else if (state.endList.size() == 1) {
+				fprintf(f,"\t\taction = %u;\n",state.endList[0].endRule);
+				fprintf(f,"\t\tmark();\n");
+			}
 
 			/*
-			 *	Find the transition which intersects
+			 *	With no transitions out, the token ends here
 			 */
 
-			uint32_t newState = (uint32_t)len;
+			if ((i != 0) && stops[i]) {
+				fprintf(f,"\t\tgoto lexDone;\n\n");
+				continue;
+			}
 
-			std::vector<OCLexDFATransition>::iterator t;
-			for (t = state.list.begin(); t != state.list.end(); ++t) {
-				if (t->set.Contains(cset)) {
-					// This transition contains our cset. Set and move on
-					newState = (uint32_t)t->state;
-					break;
-				}
+			if (i == 0) fprintf(f,"\tlexScan0:\n");
+		}
+
+		/*
+		 *	Read the next character. At EOF we are done, unless nothing
+		 *	has been read at all.
+		 */
+
+		fprintf(f,"\t\tch = input();\n");
+		if (i != 0) {
+			fprintf(f,"\t\tif (ch == -1) goto lexDone;\n");
+		} else if (entered[i]) {
+			fprintf(f,"\t\tif (ch == -1) {\n");
+			fprintf(f,"\t\t\tif (cursor == tokenStart) return -1;\n");
+			fprintf(f,"\t\t\tgoto lexDone;\n");
+			fprintf(f,"\t\t}\n");
+		} else {
+			fprintf(f,"\t\tif (ch == -1) return -1;\n");
+		}
+
+		/*
+		 *	Jump to the next state
+		 */
+
+		std::vector<uint32_t> runStart;
+		std::vector<uint32_t> runState;
+		for (uint32_t c = 0; c < 256; ++c) {
+			if ((c == 0) || (row[c] != row[c-1])) {
+				runStart.push_back(c);
+				runState.push_back(row[c]);
 			}
+		}
 
-			scratch[ptr++] = newState;
+		if (runStart.size() <= 8) {
+			WriteCodeBranch(f,runStart,runState,0,runStart.size(),2);
+		} else {
+			WriteCodeSwitch(f,row,2);
 		}
+		fprintf(f,"\n");
 	}
 
-	// New format
-	fprintf(f,"/*  StateMachineIA, StateMachineJA, StateMachineA\n");
-	fprintf(f," *\n");
-	        // 01234567890123456789012345678901234567890123456789012345678901234567890123456789
-	fprintf(f," *      Lex state machine in compressed sparce row storage format. We do this\n");
-	fprintf(f," *  in order to compact the resulting sparse matrix state machine so we don't\n");
-	fprintf(f," *  consume as much space. Decoding the new state becomes an O(log(N)) process\n");
-	fprintf(f," *  on the input character class as we use a binary search on the JA array.\n");
-	fprintf(f," *\n");
-	fprintf(f," *      See the article below for more information:\n");
-	fprintf(f," *\n");
-	fprintf(f," *      https://en.wikipedia.org/wiki/Sparse_matrix#Compressed_sparse_row_.28CSR.2C_CRS_or_Yale_format.29\n");
-	fprintf(f," */\n\n");
+	fprintf(f,"\tlexDone:\n");
+}
 
-	OCCompressStates comp(clen,len,scratch,(uint32_t)len);
+/*	OCLexCPPGenerator::WriteCodeBranch
+ *
+ *		Write a binary search over the ranges lo to hi. Range r starts at
+ *	the character runStart[r] and moves to runState[r].
+ */
 
-	fprintf(f,"static uint16_t StateMachineIA[%zu] = {\n",comp.iwidth);
-	WriteArray(f,comp.ia,comp.iwidth);
-	fprintf(f,"};\n\n");
+void OCLexCPPGenerator::WriteCodeBranch(FILE *f, const std::vector<uint32_t> &runStart,
+										const std::vector<uint32_t> &runState,
+										size_t lo, size_t hi, int indent)
+{
+	uint32_t len = (uint32_t)dfaStates.size();
+	std::string tabs(indent,'\t');
 
-	fprintf(f,"static uint16_t StateMachineJA[%zu] = {\n",comp.asize);
-	WriteArray(f,comp.ja,comp.asize);
-	fprintf(f,"};\n\n");
+	if (hi - lo <= 3) {
+		for (size_t r = lo; r + 1 < hi; ++r) {
+			fprintf(f,"%sif (ch < %s) goto %s;\n",tabs.c_str(),
+					CodeChar(runStart[r+1]).c_str(),CodeLabel(runState[r],len).c_str());
+		}
+		fprintf(f,"%sgoto %s;\n",tabs.c_str(),CodeLabel(runState[hi-1],len).c_str());
+		return;
+	}
 
-	fprintf(f,"static uint16_t StateMachineA[%zu] = {\n",comp.asize);
-	WriteArray(f,comp.a,comp.asize);
-	fprintf(f,"};\n\n");
+	size_t mid = (lo + hi) / 2;
+	fprintf(f,"%sif (ch < %s) {\n",tabs.c_str(),CodeChar(runStart[mid]).c_str());
+	WriteCodeBranch(f,runStart,runState,lo,mid,indent+1);
+	fprintf(f,"%s}\n",tabs.c_str());
+	WriteCodeBranch(f,runStart,runState,mid,hi,indent);
+}
 
-	free(scratch);
+/*	OCLexCPPGenerator::WriteCodeSwitch
+ *
+ *		Write a switch on the character for the row of transitions provided.
+ *	The state moved to on the most characters is the default case.
+ */
+
+void OCLexCPPGenerator::WriteCodeSwitch(FILE *f, const uint32_t *next, int indent)
+{
+	uint32_t len = (uint32_t)dfaStates.size();
+	std::string tabs(indent,'\t');
+
+	std::map<uint32_t,uint32_t> count;
+	for (uint32_t c = 0; c < 256; ++c) ++count[next[c]];
+
+	uint32_t def = next[0];
+	std::map<uint32_t,uint32_t>::iterator iter;
+	for (iter = count.begin(); iter != count.end(); ++iter) {
+		if (iter->second > count[def]) def = iter->first;
+	}
+
+	fprintf(f,"%sswitch (ch) {\n",tabs.c_str());
+
+	bool written[256] = { false };
+	for (uint32_t c = 0; c < 256; ++c) {
+		if ((next[c] == def) || written[c]) continue;
+
+		uint32_t n = 0;
+		for (uint32_t d = c; d < 256; ++d) {
+			if (next[d] != next[c]) continue;
+			written[d] = true;
+
+			if ((n % 8) == 0) {
+				if (n) fprintf(f,"\n");
+				fprintf(f,"%s\tcase %s:",tabs.c_str(),CodeChar(d).c_str());
+			} else {
+				fprintf(f," case %s:",CodeChar(d).c_str());
+			}
+			++n;
+		}
+		fprintf(f,"\n%s\t\tgoto %s;\n",tabs.c_str(),CodeLabel(next[c],len).c_str());
+	}
+
+	fprintf(f,"%s\tdefault:\n",tabs.c_str());
+	fprintf(f,"%s\t\tgoto %s;\n",tabs.c_str(),CodeLabel(def,len).c_str());
+	fprintf(f,"%s}\n",tabs.c_str());
 }
 
 /*	OCLexCPPGenerator::WriteActions
@@ -799,7 +2604,7 @@ void OCLexCPPGenerator::WriteStarts(FILE *f, const char *className)
 	fprintf(f," *  determines the proper end rule given the current start\n");
 	fprintf(f," *  conditionals.\n");
 	fprintf(f," */\n\n");
-	fprintf(f,"uint16_t %s::conditionalAction(uint16_t state)\n",className);
+	fprintf(f,"uint32_t %s::conditionalAction(uint32_t state)\n",className);
 	fprintf(f,"{\n");
 	fprintf(f,"    switch (state) {\n");
 	fprintf(f,"        default:\n");
@@ -881,7 +2686,12 @@ void OCLexCPPGenerator::WriteStarts(FILE *f, const char *className)
 
 void OCLexCPPGenerator::WriteOCHeader(const char *className, const char *outName, FILE *f)
 {
+	ChooseFormat();
+
 	fprintf(f,GHeader1,outName,outName,outName);
+	if (!trackLines) {
+		fprintf(f,"#include <vector>\n\n");
+	}
 
 	// Declarations
 	fprintf(f,"%s\n\n",declCode.c_str());
@@ -905,14 +2715,29 @@ void OCLexCPPGenerator::WriteOCHeader(const char *className, const char *outName
 		fprintf(f,"#endif\n");
 	}
 
-	fprintf(f,GHeader2,className,className,className,className,
-					   className,className);
+	fprintf(f,GHeader2,className,className,className,className,className,
+					   copyText ? GTextField : "",className,className,
+					   trackLines ? GLinesPublic : GOffsetPublic);
 
 	// Class global declarations
 	fprintf(f,"%s\n\n",classGlobal.c_str());
 
 	// Internal declarations
-	fprintf(f,"%s",GHeader3);
+	std::vector<Loop> loops;
+	FindLoops(loops);
+
+	fprintf(f,GHeader3,trackLines ? GLinesFields : GOffsetFields,className);
+	if (!trackLines) {
+		fprintf(f,"%s",GOffsetHeader);
+	}
+	if (lazyDFA) {
+		fprintf(f,"\n%s",GLazyHeader);
+	} else if (format == KTablePair) {
+		const char *params = trackLines ? "int32_t line, int32_t column" : "void";
+		fprintf(f,GPairHeader,params,params);
+	} else if (!loops.empty()) {
+		fprintf(f,"%s",GLoopHeader);
+	}
 
 	// Local declarations
 	fprintf(f,"%s\n",classLocal.c_str());
@@ -929,25 +2754,109 @@ void OCLexCPPGenerator::WriteOCHeader(const char *className, const char *outName
 
 void OCLexCPPGenerator::WriteOCFile(const char *className, const char *outName, FILE *f)
 {
+	tableBytes = 0;
+	blob = OCTableBlob();
+
+	// States which loop back to themselves, and which end the token
+	std::vector<Loop> loops;
+	std::vector<uint8_t> stops;
+	ChooseFormat();
+	FindLoops(loops);
+	FindStops(stops);
+	if (verbose && !lazyDFA) {
+		ReportBackup();
+	}
+
+	// Tell the user if the table format they asked for is not used
+	if ((tableFormat != KTableAuto) && (lazyDFA || (format != tableFormat))) {
+		static const char *names[] = { "auto", "comb", "dense", "byte", "code", "pair" };
+		fprintf(stderr,"Warning: -t %s is not used, as %s\n",names[tableFormat],
+				lazyDFA ? "the DFA is built as the lexer runs" : "it does not fit in the -b budget");
+	}
+
 	// Standard header
 	fprintf(f,GSource1,outName,outName);
+	if (lazyDFA || !trackLines) {
+		fprintf(f,"#include <algorithm>\n");
+	}
+	if (!loops.empty() || !trackLines) {
+		fprintf(f,"%s",GLoopInclude);
+	}
 
 	// State declarations
 	WriteStates(f);
+	if (!loops.empty()) {
+		WriteLoopStates(f,loops);
+	}
+	if (!stops.empty() && (format != KTableCode)) {
+		WriteStopStates(f,stops);
+	}
 
 	// Start class declaration
-	fprintf(f,GSource2,className,className,className,className);
+	fprintf(f,GSource2,className,className,className,className,className,
+					   className,className,className,className,className,
+					   trackLines ? GLinesInit : GOffsetInit);
+
+	if (lazyDFA) {
+		fprintf(f,"\n\tlazyNext = NULL;\n");
+		fprintf(f,"\tlazyRule = NULL;\n");
+		fprintf(f,"\tlazySetStart = NULL;\n");
+		fprintf(f,"\tlazySets = NULL;\n");
+		fprintf(f,"\tlazyHash = NULL;\n");
+		fprintf(f,"\tlazyMark = NULL;\n");
+		fprintf(f,"\tlazyWork = NULL;\n");
+		fprintf(f,"\tlazyInit();\n");
+	}
 
 	fprintf(f,"%s\n",classInit.c_str());
 
 	fprintf(f,GSource3,className,className,className,className);
+	if (lazyDFA) {
+		fprintf(f,"\tlazyFree();\n");
+	}
 
 	// Dealloc code
 	fprintf(f, "%s\n", classFinish.c_str());
 
-	fprintf(f,GSource4,className,className,className,className,
-					   className,className,className,className,
-					   className,className);
+	fprintf(f,GSource4,className,className,
+					   trackLines ? GLinesMark : "",
+					   className,className,
+					   trackLines ? GLinesReset : "",
+					   className,
+					   trackLines ? GLinesInput : "",
+					   className,
+					   trackLines ? "" : GOffsetSlide,
+					   className,className,
+					   trackLines ? GLinesSOL : GOffsetSOL);
+
+	// State lookup
+	if (lazyDFA) {
+		fprintf(f,GLazySource,className,className,className,className,
+							  className,className,className);
+	} else if (format == KTableDense) {
+		fprintf(f,GSourceDense,className);
+	} else if (format == KTableByte) {
+		fprintf(f,GSourceByte,className);
+	} else if (format == KTablePair) {
+		const char *params = trackLines ? "int32_t line, int32_t column" : "void";
+		fprintf(f,GSourceDense,className);
+		fprintf(f,GSourcePair,className,params,trackLines ? GLinesUnput : "",
+							  className,params,trackLines ? GLinesMarkPair : "");
+	} else if (format != KTableCode) {
+		fprintf(f,GSourceTable,className);
+	}
+	if (!loops.empty()) {
+		fprintf(f,GSourceLoop,className,className,
+							  trackLines ? GLinesLoopRun : "",
+							  trackLines ? GLinesLoopByte : "");
+	}
+
+	if (trackLines) {
+		fprintf(f,GSourceFile,className,className);
+	} else {
+		fprintf(f,GOffsetFile,className,className,className,className,className,
+							  className,className,className,className,className);
+	}
 
 	// Post class declarations. We embed in our class
 	fprintf(f,"%s\n\n",endCode.c_str());
@@ -956,7 +2865,22 @@ void OCLexCPPGenerator::WriteOCFile(const char *className, const char *outName,
 	WriteStarts(f,className);
 
 	// Lexer engine
-	fprintf(f,GSource5,className,className,className);
+	const char *start = trackLines ? GLinesStart : "";
+	if (format == KTableCode) {
+		fprintf(f,GCodeSource5,className,className,className,start);
+		WriteCodeDFA(f,stops);
+	} else if (format == KTablePair) {
+		const char *mid = trackLines ? "midLine, midColumn" : "";
+		fprintf(f,GPairSource5,className,className,className,start,
+							   trackLines ? GLinesMid : "",mid,mid);
+	} else {
+		fprintf(f,GSource5,className,className,className,start,
+						   (format == KTableByte) ? "(uint32_t)ch" : "CharClass[ch]",
+						   lazyDFA ? "lazyAction(state)" : "StateActions[state]",
+						   stops.empty() ? "" : GStateStop,
+						   loops.empty() ? "" : GLoopCall);
+	}
+	fprintf(f,GSourceAction,copyText ? GSourceText : "");
 
 	// Action states
 	WriteActions(f);
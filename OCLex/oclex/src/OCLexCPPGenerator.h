@@ -18,6 +18,27 @@
 /*																		*/
 /************************************************************************/
 
+/*	OCLexTableEnum
+ *
+ *		The format of the state transition table. Compressed tables use row
+ *	displacement. Dense tables hold every state and character class, and
+ *	byte tables every state and character, so the character class lookup
+ *	is skipped. Code writes no tables at all; each state is written as a
+ *	block of code which jumps directly to the next. Pair adds a table for
+ *	two characters at a time to a dense table, if both fit in tableBudget
+ *	bytes. Auto uses a dense table if it fits in tableBudget bytes.
+ */
+
+typedef enum OCLexTableEnum
+{
+	KTableAuto,
+	KTableCompressed,
+	KTableDense,
+	KTableByte,
+	KTableCode,
+	KTablePair
+} OCLexTableEnum;
+
 /*	OCLexCPPGenerator
  *
  *		Inherits from the DFA and contains the code which writes the
@@ -29,6 +50,13 @@ class OCLexCPPGenerator : public OCLexDFA
 	public:
 		OCLexCPPGenerator(std::map<std::string,std::string> &defn): OCLexDFA(defn)
 			{
+				tableFormat = KTableAuto;
+				tableBudget = 65536;
+				tableBytes = 0;
+				tableBlob = false;
+				copyText = true;
+				trackLines = true;
+				format = KTableCompressed;
 			}
 
 		~OCLexCPPGenerator()
@@ -42,12 +70,48 @@ class OCLexCPPGenerator : public OCLexDFA
 		void WriteOCHeader(const char *className, const char *outputName, FILE *f);
 		void WriteOCFile(const char *className, const char *outputName, FILE *f);
 
+		OCLexTableEnum tableFormat;		// transition table format
+		size_t tableBudget;				// dense table limit for KTableAuto
+		size_t tableBytes;				// size of the tables in WriteOCFile
+		bool tableBlob;					// write the tables as a string blob
+		bool copyText;					// copy each token into text
+		bool trackLines;				// keep line and column as we read
+
 	private:
+		/*
+		 *	A state which loops back to itself on the characters in set,
+		 *	which is also given as the ranges tested by the generated lexer
+		 */
+
+		struct Loop {
+			uint32_t state;
+			uint8_t set[32];
+			uint8_t range[9];				// lo, span pairs, then invert
+		};
+
+		OCLexTableEnum format;			// format used by WriteOCFile
+		OCTableBlob blob;				// writes the tables, if tableBlob is set
+
 		void WriteStarts(FILE *f, const char *className);
-		void WriteArray(FILE *f, uint32_t *list, size_t len);
+		void WriteArray(FILE *f, uint32_t *list, size_t len, size_t width);
+		void WriteTable(FILE *f, const char *name, uint32_t *list, size_t len, size_t width = 0);
+		static size_t TypeWidth(uint32_t max);
 		void WriteActions(FILE *f);
 
+		void ChooseFormat();
 		void WriteStates(FILE *f);
+		void WriteLazyStates(FILE *f);
+		void FindLoops(std::vector<Loop> &loops);
+		void WriteLoopStates(FILE *f, const std::vector<Loop> &loops);
+		void FindStops(std::vector<uint8_t> &stops);
+		void ReportBackup();
+		void WriteStopStates(FILE *f, const std::vector<uint8_t> &stops);
+
+		void WriteCodeDFA(FILE *f, const std::vector<uint8_t> &stops);
+		void WriteCodeBranch(FILE *f, const std::vector<uint32_t> &runStart,
+							 const std::vector<uint32_t> &runState,
+							 size_t lo, size_t hi, int indent);
+		void WriteCodeSwitch(FILE *f, const uint32_t *next, int indent);
 };
 
 #endif /* OCLexCPPGenerator_h */
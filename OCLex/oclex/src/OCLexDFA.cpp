@@ -9,6 +9,19 @@
 #include "OCLexDFA.h"
 
 #include <set>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string.h>
+
+/************************************************************************/
+/*																		*/
+/*	Constants															*/
+/*																		*/
+/************************************************************************/
+
+#define MINPARALLEL		64		// fewest states worth expanding in parallel
+#define MAXBATCH		256		// most states expanded per thread at once
 
 /************************************************************************/
 /*																		*/
@@ -35,19 +48,28 @@ void OCLexDFA::AddRuleSet(std::string regex, std::string code, const OCStartStat
 	codeRules.push_back(c);
 
 	/*
-	 *	Generate the NFA for this regular expression
+	 *	Generate the NFA for this regular expression. If the expression
+	 *	is just a list of literal strings, the strings are gathered into
+	 *	a minimal automaton instead, which we build before generating
+	 *	the DFA.
 	 */
 
-	OCLexNFAReturn ret = AddRule(regex.c_str());
+	OCLexNFAReturn ret;
+	std::vector<std::string> words;
+	if (!AddRule(regex.c_str(),ret,&words)) {
+		std::vector<std::string>::iterator iter;
+		for (iter = words.begin(); iter != words.end(); ++iter) {
+			literals.AddString(*iter,ruleIndex,start.unconditional());
+		}
+		return;
+	}
 
 	/*
 	 *	Now update the end state to mark it as translating to our code
 	 *	segment. We use this during DFA generation
 	 */
 
-	OCLexNFAState &state = states[ret.end];
-	state.end = true;
-	state.endRule = ruleIndex;
+	endRule[ret.end] = ruleIndex;
 
 	/*
 	 *	And store the start state
@@ -62,119 +84,98 @@ void OCLexDFA::AddRuleSet(std::string regex, std::string code, const OCStartStat
 /*																		*/
 /************************************************************************/
 
-/*	OCLexDFA::EClosure
+/*	OCLexDFA::BuildClosures
  *
- *		Calculate e-closure of the state set provided by walking through
- *	all the possible states reachable by an e move from the list of
- *	input states
+ *		Precompute the e-closure of every NFA state: the set of all states
+ *	reachable by zero or more e moves. Each closure is stored as a sorted
+ *	run in closureList, with closureStart indexing the start of each run.
+ *	This is done once, so the closure of a DFA state becomes the union of
+ *	the precomputed closures of its NFA states.
  */
 
-void OCLexDFA::EClosure(OCIntegerSet &set)
+void OCLexDFA::BuildClosures()
 {
-	std::set<uint32_t> visited;
-
-	/*
-	 *	This repeats until we've discovered the set of all states that
-	 *	can be reached via e closure from the input state.
-	 */
-
-	for (;;) {
-		/*
-		 *	Find the first unvisited state in set
-		 */
+	uint32_t i,len = StateCount();
 
-		uint32_t state = 0;
-		bool found = false;
-		size_t i,len = set.Size();
-		for (i = 0; i < len; ++i) {
-			state = set.Item(i);
-			if (visited.end() == visited.find(state)) {
-				// Item not found, so bounce
-				found = true;
-				break;
-			}
-		}
+	closureStart.resize(len + 1);
+	closureList.clear();
 
-		if (!found) return;		// Finished closure of set.
-		visited.insert(state);
+	std::vector<uint32_t> mark(len, 0);
 
+	std::vector<uint32_t> stack;
+	for (i = 0; i < len; ++i) {
 		/*
-		 *	Now visit all the e-reachable items for this state
+		 *	Walk the e transitions from this state. The mark array notes
+		 *	the states we've visited; we use i+1 as the visit stamp so we
+		 *	don't need to clear the array between states.
 		 */
 
-		OCLexNFAState &s = states[state];
-		std::list<OCLexNFATransition>::iterator iter;
-		for (iter = s.list.begin(); iter != s.list.end(); ++iter) {
-			if (iter->e) {
-				/*
-				 *	Add the state we can reach via an e transition
-				 */
+		size_t base = closureList.size();
+		closureStart[i] = (uint32_t)base;
+
+		stack.push_back(i);
+		mark[i] = i + 1;
+		while (!stack.empty()) {
+			uint32_t state = stack.back();
+			stack.pop_back();
+			closureList.push_back(state);
 
-				set.Add(iter->state);
+			for (OCLexNFAEdge *edge = eEdges[state]; edge; edge = edge->next) {
+				if (mark[edge->state] != i + 1) {
+					mark[edge->state] = i + 1;
+					stack.push_back(edge->state);
+				}
 			}
 		}
+
+		std::sort(closureList.begin() + base, closureList.end());
 	}
+	closureStart[len] = (uint32_t)closureList.size();
 }
 
-/*	OCLexDFA::SplitCharSet
+/*	OCLexDFA::EClosure
  *
- *		Split the character set. This looks at the list of character
- *	sets and splits everything apart until each character set does not
- *	contain the others, and the union of all character sets include all
- *	the characters of the supplied list
+ *		Calculate e-closure of the state set provided by taking the union
+ *	of the precomputed closures of each of the input states. The mark
+ *	array is used to skip states we've already added, so this runs in
+ *	time proportional to the size of the closures being merged.
  */
 
-void OCLexDFA::SplitCharSet(std::vector<OCCharSet> &set)
+void OCLexDFA::EClosure(OCIntegerSet &set, Scratch &scratch) const
 {
-	if (set.size() <= 1) return;		// Nothing to split
-
-	bool split;
-	do {
-		split = false;
-		size_t len = set.size();
-		for (size_t i = 0; (i < len) && !split; ++i) {
-			for (size_t j = i+1; j < len; ++j) {
-				/*
-				 *	See if the item at i & j is non-zero.
-				 */
-
-				OCCharSet &a = set[i];
-				OCCharSet &b = set[j];
-				OCCharSet c = a & b;
-
-				if (!c.IsEmpty()) {
-					/*
-					 *	a and b overlap. There can be two or three
-					 *	valid non-overlapping items; if two, then one
-					 *	of the following operations will hit zero.
-					 */
-
-					a -= c;
-					b -= c;
-					if (a.IsEmpty()) {
-						set[i] = c;
-						if (b.IsEmpty()) {
-							// Degenerate and interesting case. We truncate
-							// b, update a, and continue
-							set.erase(set.begin() + j);
-						}
-					} else if (b.IsEmpty()) {
-						set[j] = c;
-					} else {
-						set.push_back(c);
-					}
+	/*
+	 *	Advance the stamp, clearing the mark array if it wraps around
+	 */
 
-					/*
-					 *	We've now split a and b into non-overlapping
-					 *	elements, so mark as split, escape to start over.
-					 */
+	if (++scratch.stamp == 0) {
+		std::fill(scratch.mark.begin(), scratch.mark.end(), 0);
+		scratch.stamp = 1;
+	}
 
-					split = true;
-					break;
-				}
+	std::vector<uint32_t> &list = scratch.list;
+	list.clear();
+
+	OCIntegerSet::Iterator iter(set);
+	uint32_t state;
+	while (iter.Next(state)) {
+		uint32_t j,end = closureStart[state+1];
+		for (j = closureStart[state]; j < end; ++j) {
+			uint32_t c = closureList[j];
+			if (scratch.mark[c] != scratch.stamp) {
+				scratch.mark[c] = scratch.stamp;
+				list.push_back(c);
 			}
 		}
-	} while (split);
+	}
+
+	/*
+	 *	If the set was a single state, the result is already sorted
+	 */
+
+	if (set.Size() > 1) {
+		std::sort(list.begin(), list.end());
+	}
+	set.Assign(list.data(), list.size());
 }
 
 /************************************************************************/
@@ -203,16 +204,15 @@ void OCLexDFA::FindEndRule(OCLexDFAState &state, const OCIntegerSet &set)
 	 *	Search for all potential end rules
 	 */
 
-	size_t i,len = set.Size();
-	for (i = 0; i < len; ++i) {
-		uint32_t nfaState = set.Item(i);
-
-		const OCLexNFAState &s = states[nfaState];
-		if (s.end) {
-			OCStartState start = codeRules[s.endRule].start;
+	OCIntegerSet::Iterator iter(set);
+	uint32_t nfaState;
+	while (iter.Next(nfaState)) {
+		uint32_t rule = endRule[nfaState];
+		if (rule != NFA_NOEND) {
+			OCStartState start = codeRules[rule].start;
 
 			OCLexDFAEnd erule;
-			erule.endRule = s.endRule;
+			erule.endRule = rule;
 			erule.startState = start;
 
 			endList.push_back(erule);
@@ -227,7 +227,7 @@ void OCLexDFA::FindEndRule(OCLexDFAState &state, const OCIntegerSet &set)
 		return b.endRule > a.endRule;
 	});
 
-	len = endList.size();
+	size_t i,len = endList.size();
 	if (len != 0) {
 		for (i = 0; i < len-1; ++i) {
 			if (endList[i].startState.unconditional()) {
@@ -241,12 +241,111 @@ void OCLexDFA::FindEndRule(OCLexDFAState &state, const OCIntegerSet &set)
 	state.endList = endList;
 }
 
+/*	OCLexDFA::ExpandState
+ *
+ *		Find the transitions out of the DFA state provided. For each
+ *	character class with a transition, this finds the set of NFA states
+ *	we move to, and takes its closure. This only reads the NFA and the set
+ *	map, so it is safe to run for several states at once provided each
+ *	thread has its own scratch space.
+ */
+
+void OCLexDFA::ExpandState(uint32_t stateID, Scratch &scratch, Expansion &exp) const
+{
+	const OCIntegerSet &state = setMap.Item(stateID);
+	std::vector<uint16_t> &touched = scratch.touched;
+
+	/*
+	 *	Accumulate the NFA states we move to for each character class.
+	 *	Each NFA transition covers a precomputed list of classes, so
+	 *	this is a simple scatter into the per-class move sets.
+	 */
+
+	touched.clear();
+
+	OCIntegerSet::Iterator iter(state);
+	uint32_t nfaState;
+	while (iter.Next(nfaState)) {
+		for (OCLexNFAEdge *edge = charEdges[nfaState]; edge; edge = edge->next) {
+			const std::vector<uint16_t> &list = classLists[edge->set];
+			std::vector<uint16_t>::const_iterator citer;
+			for (citer = list.begin(); citer != list.end(); ++citer) {
+				OCIntegerSet &move = scratch.moves[*citer];
+				if (move.Size() == 0) touched.push_back(*citer);
+				move.Add(edge->state);
+			}
+		}
+	}
+
+	std::sort(touched.begin(),touched.end());
+
+	/*
+	 *	Now take the closure of each. We swap the result into the
+	 *	expansion so that both keep their storage for reuse.
+	 */
+
+	size_t i,len = touched.size();
+	exp.classes = touched;
+	if (exp.targets.size() < len) exp.targets.resize(len);
+
+	for (i = 0; i < len; ++i) {
+		OCIntegerSet &move = scratch.moves[touched[i]];
+		EClosure(move,scratch);
+
+		std::swap(exp.targets[i],move);
+		move.RemoveAll();
+	}
+}
+
+/*	OCLexDFA::ExpandLevel
+ *
+ *		Expand the DFA states from lo to hi, storing the results in level.
+ *	If we have more than one thread and enough states to make it worth
+ *	while, the threads take states from a shared counter until they are
+ *	all done.
+ */
+
+void OCLexDFA::ExpandLevel(uint32_t lo, uint32_t hi, std::vector<Scratch> &scratch, std::vector<Expansion> &level) const
+{
+	std::atomic<uint32_t> next(lo);
+
+	auto work = [&](Scratch &s) {
+		for (;;) {
+			uint32_t stateID = next.fetch_add(1);
+			if (stateID >= hi) break;
+			ExpandState(stateID,s,level[stateID - lo]);
+		}
+	};
+
+	size_t i,nthreads = scratch.size();
+	if ((nthreads <= 1) || (hi - lo < MINPARALLEL)) {
+		work(scratch[0]);
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	for (i = 1; i < nthreads; ++i) {
+		pool.push_back(std::thread(work,std::ref(scratch[i])));
+	}
+	work(scratch[0]);
+
+	for (i = 0; i < pool.size(); ++i) {
+		pool[i].join();
+	}
+}
+
 /*	OCLexDFA::GenerateDFA
  *
  *		Generate the DFA from the NFA using a powerset construction
  *	algorithm at:
  *
  *		https://en.wikipedia.org/wiki/Powerset_construction
+ *
+ *		States are numbered in the order they are first reached by a
+ *	breadth-first search, with the transitions out of each state visited
+ *	in character class order. We expand a batch of states from the queue
+ *	at a time, possibly in parallel, then add the new states in that same
+ *	order, so the numbering does not depend on the number of threads.
  */
 
 bool OCLexDFA::GenerateDFA()
@@ -256,13 +355,40 @@ bool OCLexDFA::GenerateDFA()
 	 */
 
 	dfaStates.clear();
-	setMap.clear();
+	setMap.Clear();
+	lazyDFA = false;
+
+	/*
+	 *	Add the automaton for the literal strings; its start state is one
+	 *	of our start states.
+	 */
+
+	size_t literalCount = literals.Size();
+	uint32_t literalStates = StateCount();
+	if (literalCount != 0) {
+		startStates.push_back(literals.Construct(*this));
+	}
+	literalStates = StateCount() - literalStates;
 
 	/*
-	 *	Set up the state queue
+	 *	Partition the alphabet into character classes up front, so the
+	 *	powerset construction can run over class indices.
 	 */
 
-	std::list<OCIntegerSet> stateQueue;
+	BuildAlphabet();
+	BuildClosures();
+
+	/*
+	 *	Set up the scratch space for each thread
+	 */
+
+	std::vector<Scratch> scratch(threads ? threads : 1);
+	std::vector<Scratch>::iterator siter;
+	for (siter = scratch.begin(); siter != scratch.end(); ++siter) {
+		siter->moves.resize(charClasses.size());
+		siter->mark.assign(StateCount(), 0);
+		siter->stamp = 0;
+	}
 
 	/*
 	 *	Start: construct the set of start states that represent our start.
@@ -275,11 +401,9 @@ bool OCLexDFA::GenerateDFA()
 	for (i = 0; i < len; ++i) {
 		start.Add(startStates[i]);
 	}
-	EClosure(start);
+	EClosure(start,scratch[0]);
 
 	// Construct state representation and add to queue
-	uint32_t stateID = (uint32_t)dfaStates.size();
-
 	OCLexDFAState dfa;
 	FindEndRule(dfa,start);
 	dfaStates.push_back(dfa);
@@ -288,138 +412,666 @@ bool OCLexDFA::GenerateDFA()
 		fprintf(stderr,"Warning: Lex rules contains a potentially empty regular expression");
 	}
 
-	setMap[start] = stateID;
-	stateQueue.push_back(start);
+	bool added;
+	setMap.Intern(start,added);
 
 	/*
 	 *	Now run through all the states we encounter. At each point we 
 	 *	find the list of possible transitions from this state set, then
 	 *	calculate for each possible unique transition which states we
-	 *	arrive at, enqueing them as needed.
+	 *	arrive at, enqueing them as needed. States are numbered in the
+	 *	order they are added to the set map, so the map doubles as our
+	 *	queue. Each pass expands a batch of states from the front of the
+	 *	queue, bounded so that we don't hold too many results at once.
 	 */
 
-	while (!stateQueue.empty()) {
-		/*
-		 *	Get the list of possible transitions from this state. This is
-		 *	the list of all possible transitions from all the states within
-		 *	the state object representation
-		 */
+	std::vector<Expansion> level;
+	std::vector<uint32_t> target(charClasses.size());
 
-		OCIntegerSet state = stateQueue.front();
-		stateQueue.pop_front();
+	uint32_t lo = 0;
+	while (lo < setMap.Size()) {
+		uint32_t hi = (uint32_t)setMap.Size();
+		if (hi - lo > MAXBATCH * scratch.size()) {
+			hi = lo + (uint32_t)(MAXBATCH * scratch.size());
+		}
+		if (level.size() < hi - lo) level.resize(hi - lo);
 
-		stateID = setMap[state];
+		ExpandLevel(lo,hi,scratch,level);
 
-		/*
-		 *	Build total list of transitions
-		 */
+		for (uint32_t stateID = lo; stateID < hi; ++stateID) {
+			Expansion &exp = level[stateID - lo];
+
+			/*
+			 *	Determine if the states we're transitioning to exist, and
+			 *	if they do not, add them.
+			 */
+
+			len = exp.classes.size();
+			for (i = 0; i < len; ++i) {
+				OCIntegerSet &newState = exp.targets[i];
+
+				uint32_t newStateID = setMap.Intern(newState,added);
+				if (added) {
+					/*
+					 *	If we've gone over our budget, give up; the lexer
+					 *	will have to build its states as it runs.
+					 */
+
+					if (maxStates && (setMap.Size() > maxStates)) {
+						if (verbose) {
+							printf("NFA states: %u\n",StateCount());
+							printf("DFA states: more than %u; the DFA will be built lazily\n",maxStates);
+							printf("Character classes: %zu\n",charClasses.size());
+						}
+
+						dfaStates.clear();
+						setMap.Clear();
+						lazyDFA = true;
+						return true;
+					}
+
+					OCLexDFAState dfa;
+					FindEndRule(dfa,newState);
+					dfaStates.push_back(dfa);
+				}
+
+				target[exp.classes[i]] = newStateID;
+				newState.RemoveAll();
+			}
+
+			/*
+			 *	Now construct the DFA state transitions to the new DFA
+			 *	states, grouping together the classes which arrive at the
+			 *	same state.
+			 */
+
+			OCLexDFAState &dfaState = dfaStates[stateID];
+			std::vector<uint16_t>::iterator classIter;
+			for (classIter = exp.classes.begin(); classIter != exp.classes.end(); ++classIter) {
+				uint32_t newStateID = target[*classIter];
+
+				std::vector<OCLexDFATransition>::iterator t;
+				for (t = dfaState.list.begin(); t != dfaState.list.end(); ++t) {
+					if (t->state == newStateID) break;
+				}
+
+				if (t == dfaState.list.end()) {
+					OCLexDFATransition trans;
+					trans.state = newStateID;				// state we're going to
+					trans.set = charClasses[*classIter];	// transition which triggers new state
+					dfaState.list.push_back(trans);
+				} else {
+					t->set |= charClasses[*classIter];
+				}
+			}
+		}
+
+		lo = hi;
+	}
+
+	/*
+	 *	At this point we've calculated the DFA. Merge equivalent states,
+	 *	then merge the character classes the DFA does not distinguish so
+	 *	we can reduce the size of our output tables.
+	 */
+
+	size_t powersetSize = dfaStates.size();
+	MinimizeDFA();
+	MergeCharClasses();
+
+	if (verbose) {
+		printf("NFA states: %u\n",StateCount());
+		if (literalCount != 0) {
+			printf("Literal strings: %zu (%u NFA states)\n",literalCount,literalStates);
+		}
+		printf("DFA states: %zu (%zu before minimization)\n",dfaStates.size(),powersetSize);
+		printf("Character classes: %zu\n",charClasses.size());
+	}
+
+	return true;
+}
+
+/************************************************************************/
+/*																		*/
+/*	DFA Post-processing													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexDFA::BuildAlphabet
+ *
+ *		Partition the 256 characters into character classes, where every
+ *	character in a class is treated identically by every transition in
+ *	the NFA. We refine the partition once for each distinct transition set,
+ *	which takes linear time in the number of sets. Classes are numbered in
+ *	the order of their lowest character.
+ *
+ *		This also builds, for each of the NFA's character sets, the list of
+ *	classes the set covers.
+ */
+
+void OCLexDFA::BuildAlphabet()
+{
+	const std::vector<OCCharSet> &sets = charSets;
+	size_t i;
+
+	/*
+	 *	Refine the partition by each set. The characters in the set are
+	 *	moved out of their class into a new class, then the class indexes
+	 *	are compacted.
+	 */
+
+	uint16_t cls[256];
+	int16_t remap[512];
+	memset(cls,0,sizeof(cls));
+
+	uint16_t count = 1;
+	std::vector<OCCharSet>::const_iterator siter;
+	for (siter = sets.begin(); siter != sets.end(); ++siter) {
+		memset(remap,-1,sizeof(remap));
+
+		uint16_t newCount = count;
+		for (int c = 0; c < 256; ++c) {
+			if (siter->TestCharacter((unsigned char)c)) {
+				uint16_t old = cls[c];
+				if (remap[old] < 0) remap[old] = newCount++;
+				cls[c] = remap[old];
+			}
+		}
+		if (newCount == count) continue;
+
+		memset(remap,-1,sizeof(remap));
+		count = 0;
+		for (int c = 0; c < 256; ++c) {
+			if (remap[cls[c]] < 0) remap[cls[c]] = count++;
+			cls[c] = remap[cls[c]];
+		}
+	}
+
+	charClasses.clear();
+	charClasses.resize(count);
+	for (int c = 0; c < 256; ++c) {
+		charClasses[cls[c]].SetCharacter((unsigned char)c);
+	}
+
+	/*
+	 *	Now map each set to the list of classes it covers
+	 */
+
+	classLists.clear();
+	classLists.resize(sets.size());
+	for (i = 0; i < sets.size(); ++i) {
+		std::vector<uint16_t> &list = classLists[i];
+		for (uint16_t c = 0; c < count; ++c) {
+			if (sets[i].Contains(charClasses[c])) {
+				list.push_back(c);
+			}
+		}
+	}
+}
+
+/*	OCLexDFA::MergeCharClasses
+ *
+ *		The classes built by BuildAlphabet distinguish every set in the NFA;
+ *	once we have the final DFA we can merge the classes which transition to
+ *	the same state from every DFA state. Classes which never transition
+ *	anywhere are dropped, as characters with no class are treated as an
+ *	illegal transition by the generated lexers.
+ */
+
+void OCLexDFA::MergeCharClasses()
+{
+	size_t i,len = dfaStates.size();
+	size_t clen = charClasses.size();
 
-		std::vector<OCCharSet> cset;
-		std::vector<OCLexNFATransition> transitions;
+	std::map<std::vector<uint32_t>,uint32_t> columnMap;
+	std::vector<OCCharSet> merged;
 
-		size_t i,len = state.Size();
+	std::vector<uint32_t> column(len);
+	for (size_t j = 0; j < clen; ++j) {
+		bool empty = true;
 		for (i = 0; i < len; ++i) {
-			uint32_t nfaState = state.Item(i);
-			std::list<OCLexNFATransition>::iterator iter;
-
-			OCLexNFAState &nfa = states[nfaState];
-			for (iter = nfa.list.begin(); iter != nfa.list.end(); ++iter) {
-				if (!iter->e) {
-					transitions.push_back(*iter);
-					cset.push_back(iter->set);
+			uint32_t newState = (uint32_t)len;
+
+			OCLexDFAState &state = dfaStates[i];
+			std::vector<OCLexDFATransition>::iterator t;
+			for (t = state.list.begin(); t != state.list.end(); ++t) {
+				if (t->set.Contains(charClasses[j])) {
+					newState = t->state;
+					empty = false;
+					break;
 				}
 			}
+			column[i] = newState;
+		}
+		if (empty) continue;
+
+		std::map<std::vector<uint32_t>,uint32_t>::iterator f = columnMap.find(column);
+		if (f == columnMap.end()) {
+			columnMap[column] = (uint32_t)merged.size();
+			merged.push_back(charClasses[j]);
+		} else {
+			merged[f->second] |= charClasses[j];
 		}
+	}
+
+	charClasses.swap(merged);
+}
+
+/*	OCLexDFA::MinimizeDFA
+ *
+ *		Merge equivalent DFA states using Hopcroft's partition refinement
+ *	algorithm:
+ *
+ *		https://en.wikipedia.org/wiki/DFA_minimization#Hopcroft's_algorithm
+ *
+ *		Two states are only equivalent if they have the same end list, so
+ *	our initial partition groups states by the rules (and by extension the
+ *	start conditions) FindEndRule attached to each state. Missing transitions
+ *	are treated as a transition to an implicit dead state, which is also
+ *	where non-accepting states that can never reach an accepting state wind
+ *	up. Surviving states are renumbered in the order they first appear, so
+ *	the start state remains state 0.
+ */
+
+void OCLexDFA::MinimizeDFA()
+{
+	size_t i,len = dfaStates.size();
+	size_t clen = charClasses.size();
+	if ((len == 0) || (clen == 0)) return;
 
-		SplitCharSet(cset);
+	/*
+	 *	Build the dense transition table. State 'len' is the dead state
+	 */
+
+	uint32_t dead = (uint32_t)len;
+	uint32_t total = (uint32_t)len + 1;
+
+	std::vector<uint32_t> delta(total * clen, dead);
+	for (i = 0; i < len; ++i) {
+		OCLexDFAState &state = dfaStates[i];
+		for (size_t j = 0; j < clen; ++j) {
+			std::vector<OCLexDFATransition>::iterator t;
+			for (t = state.list.begin(); t != state.list.end(); ++t) {
+				if (t->set.Contains(charClasses[j])) {
+					delta[i * clen + j] = t->state;
+					break;
+				}
+			}
+		}
+	}
+
+	/*
+	 *	Build the inverse transition table: for each (class, target), the
+	 *	list of states which transition into the target on that class. This
+	 *	is stored in compressed form, indexed by class * total + target.
+	 */
+
+	std::vector<uint32_t> invStart(clen * total + 1, 0);
+	std::vector<uint32_t> invList(total * clen);
+	for (uint32_t s = 0; s < total; ++s) {
+		for (size_t c = 0; c < clen; ++c) {
+			++invStart[c * total + delta[s * clen + c] + 1];
+		}
+	}
+	for (size_t k = 1; k < invStart.size(); ++k) {
+		invStart[k] += invStart[k-1];
+	}
+	std::vector<uint32_t> invFill(invStart.begin(), invStart.end() - 1);
+	for (uint32_t s = 0; s < total; ++s) {
+		for (size_t c = 0; c < clen; ++c) {
+			invList[invFill[c * total + delta[s * clen + c]]++] = s;
+		}
+	}
+
+	/*
+	 *	Initial partition. States are grouped by their end rule lists; the
+	 *	dead state shares a block with the states that have no end rules.
+	 *	The partition is stored as a permutation of the states, with each
+	 *	block occupying a contiguous range of the permutation.
+	 */
+
+	std::map<std::vector<uint32_t>,uint32_t> endMap;
+	std::vector<uint32_t> blk(total);
+	std::vector<uint32_t> blockSize;
+
+	endMap[std::vector<uint32_t>()] = 0;
+	blockSize.push_back(0);
+	for (uint32_t s = 0; s < total; ++s) {
+		std::vector<uint32_t> key;
+		if (s < len) {
+			std::vector<OCLexDFAEnd> &endList = dfaStates[s].endList;
+			for (size_t e = 0; e < endList.size(); ++e) {
+				key.push_back(endList[e].endRule);
+			}
+		}
+
+		std::map<std::vector<uint32_t>,uint32_t>::iterator f = endMap.find(key);
+		if (f == endMap.end()) {
+			uint32_t b = (uint32_t)blockSize.size();
+			endMap[key] = b;
+			blockSize.push_back(0);
+			blk[s] = b;
+		} else {
+			blk[s] = f->second;
+		}
+		++blockSize[blk[s]];
+	}
+
+	size_t nblocks = blockSize.size();
+	std::vector<uint32_t> first(nblocks), end(nblocks), mid(nblocks);
+	std::vector<uint32_t> elems(total), loc(total);
+
+	uint32_t pos = 0;
+	for (size_t b = 0; b < nblocks; ++b) {
+		first[b] = mid[b] = end[b] = pos;
+		pos += blockSize[b];
+	}
+	for (uint32_t s = 0; s < total; ++s) {
+		uint32_t b = blk[s];
+		loc[s] = end[b];
+		elems[end[b]++] = s;
+	}
+
+	/*
+	 *	Seed the work list with every (block, class) pair.
+	 */
+
+	std::vector<std::pair<uint32_t,uint32_t> > work;
+	std::vector<bool> inWork(nblocks * clen, false);
+	for (size_t b = 0; b < nblocks; ++b) {
+		for (size_t c = 0; c < clen; ++c) {
+			work.push_back(std::pair<uint32_t,uint32_t>((uint32_t)b,(uint32_t)c));
+			inWork[b * clen + c] = true;
+		}
+	}
+
+	/*
+	 *	Refine until no splitter remains
+	 */
+
+	std::vector<uint32_t> touched;
+	std::vector<uint32_t> splitter;
+	while (!work.empty()) {
+		uint32_t b = work.back().first;
+		uint32_t c = work.back().second;
+		work.pop_back();
+		inWork[b * clen + c] = false;
+
+		/*
+		 *	Snapshot the splitter block, as marking below may reorder its
+		 *	contents, then mark every state which transitions into the
+		 *	splitter on class c by moving it to the front of its block.
+		 */
+
+		splitter.assign(elems.begin() + first[b], elems.begin() + end[b]);
+
+		touched.clear();
+		std::vector<uint32_t>::iterator si;
+		for (si = splitter.begin(); si != splitter.end(); ++si) {
+			size_t ix = c * total + *si;
+			for (uint32_t k = invStart[ix]; k < invStart[ix+1]; ++k) {
+				uint32_t s = invList[k];
+				uint32_t y = blk[s];
+				if (loc[s] < mid[y]) continue;		// already marked
+
+				if (mid[y] == first[y]) touched.push_back(y);
+
+				uint32_t other = elems[mid[y]];
+				elems[loc[s]] = other;
+				loc[other] = loc[s];
+				elems[mid[y]] = s;
+				loc[s] = mid[y];
+				++mid[y];
+			}
+		}
 
 		/*
-		 *	At this point cset contains a list of all the possible unique
-		 *	ways we can transition, and the transitions array contain all
-		 *	the NFA transitions. Now we run through all the transition
-		 *	states possible in cset, and derive the states we are
-		 *	transitioning to
-		 *
-		 *	The intent is that if we have a character c, this will be
-		 *	represented by a unique state OCLexDFAState.
+		 *	Split every touched block into its marked and unmarked parts
 		 */
 
-		std::vector<OCCharSet>::iterator csetIter;
-		for (csetIter = cset.begin(); csetIter != cset.end(); ++csetIter) {
+		std::vector<uint32_t>::iterator ti;
+		for (ti = touched.begin(); ti != touched.end(); ++ti) {
+			uint32_t y = *ti;
+			if (mid[y] == end[y]) {
+				// Entire block marked; no split
+				mid[y] = first[y];
+				continue;
+			}
+
 			/*
-			 *	Now run the list of transitions we found and stored in the
-			 *	transition list. We're accumulating all NFA states that
-			 *	cset moves to
+			 *	The marked part [first,mid) becomes the new block.
 			 */
 
-			OCIntegerSet newState;
+			uint32_t z = (uint32_t)first.size();
+			first.push_back(first[y]);
+			end.push_back(mid[y]);
+			mid.push_back(first[y]);
+			first[y] = mid[y];
+
+			for (uint32_t k = first[z]; k < end[z]; ++k) {
+				blk[elems[k]] = z;
+			}
 
-			std::vector<OCLexNFATransition>::iterator titer;
-			for (titer = transitions.begin(); titer != transitions.end(); ++titer) {
-				if (titer->set.Contains(*csetIter)) {
-					newState.Add(titer->state);
+			inWork.resize(first.size() * clen, false);
+
+			uint32_t ysize = end[y] - first[y];
+			uint32_t zsize = end[z] - first[z];
+			for (uint32_t a = 0; a < clen; ++a) {
+				if (inWork[y * clen + a]) {
+					work.push_back(std::pair<uint32_t,uint32_t>(z,a));
+					inWork[z * clen + a] = true;
+				} else {
+					uint32_t add = (zsize <= ysize) ? z : y;
+					work.push_back(std::pair<uint32_t,uint32_t>(add,a));
+					inWork[add * clen + a] = true;
 				}
 			}
+		}
+	}
 
-			EClosure(newState);
+	/*
+	 *	Renumber the surviving blocks in the order of their first state.
+	 *	States in the same block as the dead state are dropped, unless this
+	 *	is our start state.
+	 */
 
-			/*
-			 *	Determine if this state we're transitioning to exists, and
-			 *	if it does not, add it.
-			 */
+	uint32_t deadBlock = blk[dead];
+	std::vector<uint32_t> newIndex(first.size(), dead);
+	std::vector<uint32_t> rep;
+
+	for (uint32_t s = 0; s < len; ++s) {
+		uint32_t b = blk[s];
+		if ((b == deadBlock) && (s != 0)) continue;
+		if (newIndex[b] == dead) {
+			newIndex[b] = (uint32_t)rep.size();
+			rep.push_back(s);
+		}
+	}
+
+	if (rep.size() == len) return;		// Already minimal
+
+	/*
+	 *	Rebuild the DFA from the representative of each block, grouping
+	 *	the classes which transition to the same target state.
+	 */
+
+	std::vector<OCLexDFAState> minStates(rep.size());
+	for (size_t n = 0; n < rep.size(); ++n) {
+		uint32_t s = rep[n];
+		OCLexDFAState &state = minStates[n];
+		state.endList = dfaStates[s].endList;
+
+		if (blk[s] == deadBlock) continue;	// Degenerate start state
 
-			int newStateID;
-			if (setMap.end() == setMap.find(newState)) {
-				newStateID = (uint32_t)dfaStates.size();
+		std::map<uint32_t,size_t> targetMap;
+		for (size_t j = 0; j < clen; ++j) {
+			uint32_t target = delta[s * clen + j];
+			if (blk[target] == deadBlock) continue;
+			target = newIndex[blk[target]];
 
-				OCLexDFAState dfa;
-				FindEndRule(dfa,newState);
-				dfaStates.push_back(dfa);
+			std::map<uint32_t,size_t>::iterator f = targetMap.find(target);
+			if (f == targetMap.end()) {
+				targetMap[target] = state.list.size();
 
-				setMap[newState] = newStateID;
-				stateQueue.push_back(newState);
+				OCLexDFATransition t;
+				t.state = target;
+				t.set = charClasses[j];
+				state.list.push_back(t);
 			} else {
-				newStateID = setMap[newState];
+				state.list[f->second].set |= charClasses[j];
 			}
+		}
+	}
 
-			/*
-			 *	Now construct the DFA state transition to the new DFA
-			 *	state in stateID.
-			 */
+	dfaStates.swap(minStates);
+}
 
-			OCLexDFAState &dfaState = dfaStates[stateID];
+/************************************************************************/
+/*																		*/
+/*	Profile-Guided Ordering												*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexDFA::ProfileText
+ *
+ *		Run the DFA over sample input, counting the times each state is
+ *	entered and each character class is read. We lex the way the generated
+ *	lexer does: take the longest match from the start state, and start again
+ *	after it, or after one character if nothing matched. Start conditions
+ *	are ignored; any state which ends a rule is treated as a match.
+ */
+
+void OCLexDFA::ProfileText(const unsigned char *text, size_t len)
+{
+	size_t i,slen = dfaStates.size();
+	size_t clen = charClasses.size();
+	if (lazyDFA || (slen == 0)) return;
+
+	uint32_t dead = (uint32_t)slen;
+	uint32_t noClass = (uint32_t)clen;
+
+	/*
+	 *	Build the dense transition table the first time through
+	 */
 
-			OCLexDFATransition t;
-			t.state = newStateID;	// state we're going to
-			t.set = *csetIter;		// transition which triggers new state
-			dfaState.list.push_back(t);
+	if (stateHits.empty()) {
+		stateHits.resize(slen,0);
+		classHits.resize(clen,0);
+
+		profileClass.assign(256,noClass);
+		for (i = 0; i < clen; ++i) {
+			for (int c = 0; c < 256; ++c) {
+				if (charClasses[i].TestCharacter((unsigned char)c)) {
+					profileClass[c] = (uint32_t)i;
+				}
+			}
+		}
+
+		profileNext.assign(slen * clen,dead);
+		for (i = 0; i < slen; ++i) {
+			std::vector<OCLexDFATransition>::iterator t;
+			for (t = dfaStates[i].list.begin(); t != dfaStates[i].list.end(); ++t) {
+				for (size_t j = 0; j < clen; ++j) {
+					if (t->set.Contains(charClasses[j])) {
+						profileNext[i * clen + j] = t->state;
+					}
+				}
+			}
 		}
 	}
 
+	profileBytes += len;
+
+	size_t pos = 0;
+	while (pos < len) {
+		uint32_t state = 0;
+		size_t match = pos;
+
+		++stateHits[0];
+		for (i = pos; i < len; ++i) {
+			uint32_t c = profileClass[text[i]];
+			if (c == noClass) break;
+
+			uint32_t next = profileNext[state * clen + c];
+			if (next == dead) break;
+
+			++classHits[c];
+			++stateHits[next];
+			state = next;
+
+			if (!dfaStates[state].endList.empty()) match = i + 1;
+		}
+
+		pos = (match > pos) ? match : pos + 1;
+	}
+}
+
+/*	OCLexDFA::ReorderDFA
+ *
+ *		Renumber the DFA states and character classes from the profile, so
+ *	the states used most are contiguous at the start of the state tables,
+ *	and the classes used most come first in each row. The start state stays
+ *	state 0. States and classes with the same count keep their order, so
+ *	those never reached stay in the order the DFA was built.
+ */
+
+void OCLexDFA::ReorderDFA()
+{
+	size_t i,slen = dfaStates.size();
+	size_t clen = charClasses.size();
+	if (stateHits.empty()) return;
+
 	/*
-	 *	At this point we've calculated the DFA. The last step, used when
-	 *	generating the tables, is to build the character class set so
-	 *	we can reduce the size of our output tables
+	 *	States
 	 */
 
-	// Accumulate a unique list of all possible character transitions
-	std::set<OCCharSet> charSet;
-	std::vector<OCLexDFAState>::iterator dfaIter;
-	for (dfaIter = dfaStates.begin(); dfaIter != dfaStates.end(); ++dfaIter) {
-		std::vector<OCLexDFATransition>::iterator titer;
-		for (titer = dfaIter->list.begin(); titer != dfaIter->list.end(); ++titer) {
-			charSet.insert(titer->set);
+	std::vector<uint32_t> order(slen);
+	for (i = 0; i < slen; ++i) order[i] = (uint32_t)i;
+	std::stable_sort(order.begin() + 1,order.end(),[this](uint32_t a, uint32_t b) {
+		return stateHits[a] > stateHits[b];
+	});
+
+	std::vector<uint32_t> newIndex(slen);
+	for (i = 0; i < slen; ++i) newIndex[order[i]] = (uint32_t)i;
+
+	std::vector<OCLexDFAState> states(slen);
+	for (i = 0; i < slen; ++i) {
+		states[i] = dfaStates[order[i]];
+
+		std::vector<OCLexDFATransition>::iterator t;
+		for (t = states[i].list.begin(); t != states[i].list.end(); ++t) {
+			t->state = newIndex[t->state];
 		}
 	}
+	dfaStates.swap(states);
 
-	// Uniquely identify the sets
-	charClasses.clear();
-	std::set<OCCharSet>::iterator setIter;
-	for (setIter = charSet.begin(); setIter != charSet.end(); ++setIter) {
-		charClasses.push_back(*setIter);
-	}
+	/*
+	 *	Character classes. The transitions hold character sets rather than
+	 *	class indexes, so nothing else needs to change.
+	 */
 
-	SplitCharSet(charClasses);
+	std::vector<uint32_t> corder(clen);
+	for (i = 0; i < clen; ++i) corder[i] = (uint32_t)i;
+	std::stable_sort(corder.begin(),corder.end(),[this](uint32_t a, uint32_t b) {
+		return classHits[a] > classHits[b];
+	});
 
-	return true;
+	std::vector<OCCharSet> classes(clen);
+	for (i = 0; i < clen; ++i) classes[i] = charClasses[corder[i]];
+	charClasses.swap(classes);
+
+	if (verbose) {
+		size_t used = 0;
+		for (i = 0; i < slen; ++i) {
+			if (stateHits[i]) ++used;
+		}
+		printf("Profile: %llu bytes, %zu of %zu DFA states used\n",
+				(unsigned long long)profileBytes,used,slen);
+	}
+
+	profileBytes = 0;
+	stateHits.clear();
+	classHits.clear();
+	profileClass.clear();
+	profileNext.clear();
 }
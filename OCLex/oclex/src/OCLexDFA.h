@@ -10,6 +10,7 @@
 #define OCLexDFA_h
 
 #include "OCLexNFA.h"
+#include "OCLexTrie.h"
 #include "OCStartState.h"
 
 #include <stdio.h>
@@ -75,6 +76,11 @@ class OCLexDFA: public OCLexNFA
 	public:
 		OCLexDFA(std::map<std::string,std::string> &defn) : OCLexNFA(defn)
 			{
+				verbose = false;
+				threads = 1;
+				maxStates = 0;
+				lazyDFA = false;
+				profileBytes = 0;
 			}
 
 		~OCLexDFA()
@@ -98,6 +104,23 @@ class OCLexDFA: public OCLexNFA
 
 		bool GenerateDFA();
 
+		/*
+		 *	Profile-guided ordering. Sample input is run through the DFA
+		 *	with ProfileText, then ReorderDFA renumbers the states and the
+		 *	character classes so the most used come first.
+		 */
+
+		void ProfileText(const unsigned char *text, size_t len);
+		void ReorderDFA();
+
+		/*
+		 *	Options
+		 */
+
+		bool verbose;					// report state counts to stdout
+		uint32_t threads;				// threads used to build the DFA
+		uint32_t maxStates;				// state budget, or 0 if none
+
 		/*
 		 *	Final DFA structure
 		 */
@@ -115,8 +138,17 @@ class OCLexDFA: public OCLexNFA
 		std::vector<CodeRule> codeRules;
 		std::vector<OCLexDFAState> dfaStates;
 
+		/*
+		 *	Set if the powerset construction went over maxStates. In that
+		 *	case dfaStates is empty and the generated lexer must build its
+		 *	DFA states from the NFA as it runs. The NFA, its closures and
+		 *	the character classes from BuildAlphabet are left in place for
+		 *	the generator.
+		 */
+
+		bool lazyDFA;
 
-	private:
+	protected:
 		/*
 		 *	Store the start states and the list of code rules
 		 *	which are melded into the underlying NFA
@@ -125,14 +157,81 @@ class OCLexDFA: public OCLexNFA
 		std::vector<uint32_t> startStates;
 
 		/*
-		 *	Support for mapping the power set to a state index
+		 *	Rules which only match literal strings are gathered here, and
+		 *	built into a minimal automaton when we generate the DFA
+		 */
+
+		OCLexTrie literals;
+
+		/*
+		 *	Support for mapping the power set to a state index. The index
+		 *	of each set in the map is its DFA state index.
 		 */
 
-		std::map<OCIntegerSet,uint32_t> setMap;
+		OCIntegerSetMap setMap;
 
-		void EClosure(OCIntegerSet &set);
-		void SplitCharSet(std::vector<OCCharSet> &set);
+		/*
+		 *	Precomputed e-closure of each NFA state, stored as a sorted run
+		 *	in closureList starting at closureStart[state]
+		 */
+
+		std::vector<uint32_t> closureStart;
+		std::vector<uint32_t> closureList;
+
+		void BuildClosures();
 		void FindEndRule(OCLexDFAState &state, const OCIntegerSet &set);
+
+		/*
+		 *	Powerset construction. The DFA states are expanded a level of
+		 *	the breadth-first search at a time; the expansion of each state
+		 *	is independent, so a level can be split across threads. Each
+		 *	thread has its own scratch space.
+		 */
+
+		struct Scratch {
+			std::vector<OCIntegerSet> moves;	// by character class
+			std::vector<uint16_t> touched;		// classes with moves
+			std::vector<uint32_t> mark;			// used by EClosure
+			std::vector<uint32_t> list;
+			uint32_t stamp;
+		};
+
+		struct Expansion {
+			std::vector<uint16_t> classes;		// ascending
+			std::vector<OCIntegerSet> targets;	// NFA states reached by class
+		};
+
+		void EClosure(OCIntegerSet &set, Scratch &scratch) const;
+		void ExpandState(uint32_t stateID, Scratch &scratch, Expansion &exp) const;
+		void ExpandLevel(uint32_t lo, uint32_t hi, std::vector<Scratch> &scratch, std::vector<Expansion> &level) const;
+
+		/*
+		 *	Alphabet partition. The character classes are computed from the
+		 *	NFA before the powerset construction, along with the list of
+		 *	classes covered by each of the NFA's character sets.
+		 */
+
+		std::vector<std::vector<uint16_t> > classLists;	// by charSets index
+
+		void BuildAlphabet();
+
+		/*
+		 *	Post-processing of the constructed DFA
+		 */
+
+		void MinimizeDFA();
+		void MergeCharClasses();
+
+		/*
+		 *	Profile counts, and the dense transition table used to run the
+		 *	DFA over the sample input
+		 */
+
+		uint64_t profileBytes;
+		std::vector<uint64_t> stateHits;		// by DFA state
+		std::vector<uint64_t> classHits;		// by character class
+		std::vector<uint32_t> profileClass;		// class of each character
+		std::vector<uint32_t> profileNext;		// state * classes + class
 };
 
 #endif /* OCLexDFA_h */
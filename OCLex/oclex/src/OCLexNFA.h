@@ -26,46 +26,23 @@
 /*																		*/
 /************************************************************************/
 
-/*	OCLexNFATransition
+/*	OCLexNFAEdge
  *
  *		Represents an outbound transition from an old state to a new state.
- *	This represents the character set for the outbound state, and a pointer
- *	to the new state
+ *	Edges are allocated from the NFA's pool and chained into a list for
+ *	each state; empty transitions and character transitions are kept in
+ *	separate lists. The character set of a character transition is stored
+ *	once in the NFA's table of character sets, and referred to by index.
  */
 
-struct OCLexNFATransition
+struct OCLexNFAEdge
 {
-	OCCharSet	set;
-	bool		e;			// true if this is an empty transition
-	uint32_t	state;
-
-	OCLexNFATransition()
-		{
-			e = false;
-			state = 0;
-		}
+	OCLexNFAEdge	*next;
+	uint32_t		state;		// state we transition to
+	uint32_t		set;		// index into OCLexNFA::charSets
 };
 
-/*	OCLexNFAState
- *
- *		A state object; this represents a state, which is a list of
- *	transition objects to other states, and a marker to determine if this
- *	is an end state (and whose end-state this is)
- */
-
-struct OCLexNFAState
-{
-	std::list<OCLexNFATransition> list;
-
-	bool						end;		// End marker of rule?
-	uint32_t					endRule;	// Rule ID that this ends
-
-	OCLexNFAState()
-		{
-			end = false;
-			endRule = 0;
-		}
-};
+#define NFA_NOEND		0xFFFFFFFF	// endRule for states that end no rule
 
 /*	OCLexNFA
  *
@@ -104,27 +81,38 @@ class OCLexNFA
 			{
 			}
 
-		OCLexNFAReturn AddRule(const char *regex)
-			{
-				return Construct(regex);
-			}
+		bool AddRule(const char *regex, OCLexNFAReturn &ret, std::vector<std::string> *words = NULL);
 
-		std::vector<OCLexNFAState> states;
 		std::list<std::string> ruleStates;
 
-	private:
-		uint32_t stateIndex;
-		std::map<std::string,std::string> &definitions;
-		std::set<std::string> inDefinition;
+		/*
+		 *	NFA storage. The states are held in parallel arrays indexed by
+		 *	state number.
+		 */
+
+		std::vector<OCLexNFAEdge *> eEdges;		// empty transitions
+		std::vector<OCLexNFAEdge *> charEdges;	// character transitions
+		std::vector<uint32_t> endRule;			// rule ended, or NFA_NOEND
+		std::vector<OCCharSet> charSets;		// distinct transition sets
 
-		OCLexNFAReturn Construct(const char *&regex);
-		char EscapeCharacter(const char *&regex);
+		uint32_t StateCount() const
+			{
+				return (uint32_t)endRule.size();
+			}
 
-		OCLexNFAReturn ConstructString(const char *&regex);
-		OCLexNFAReturn ConstructCharSet(const char *&regex);
-		OCLexNFAReturn ConstructDefinition(const char *&regex);
+		/*
+		 *	Construction
+		 */
 
 		uint32_t NewState();
+		void AddEpsilon(uint32_t from, uint32_t to);
+		void AddTransition(uint32_t from, uint32_t to, const OCCharSet &set);
+
+	private:
+		uint32_t stateIndex;
+		OCAlloc pool;
+		std::map<OCCharSet,uint32_t> charSetIndex;
+		std::map<std::string,std::string> &definitions;
 };
 
 
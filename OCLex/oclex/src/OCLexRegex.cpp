@@ -0,0 +1,985 @@
+//
+//  OCLexRegex.cpp
+//  oclex
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include "OCLexRegex.h"
+#include "OCLexNFA.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+/****
+
+Lex-style regular expressions definition from
+http://dinosaur.compilertools.net/lex/index.html
+
+               x        the character "x"
+               "x"      an "x", even if x is an operator.
+               \x       an "x", even if x is an operator.
+               [xy]     the character x or y.
+               [x-z]    the characters x, y or z.
+               [^x]     any character but x.
+               .        any character but newline.
+               ^x       an x at the beginning of a line.
+               <y>x     an x when Lex is in start condition y.
+               x$       an x at the end of a line.
+               x?       an optional x.
+               x*       0,1,2, ... instances of x.
+               x+       1,2,3, ... instances of x.
+               x|y      an x or a y.
+               (x)      an x.
+ ns            x/y      an x but only if followed by y.
+               {xx}     the translation of xx from the
+                        definitions section.
+ ns            x{m,n}   m through n occurrences of x
+
+****/
+
+/************************************************************************/
+/*																		*/
+/*	Construction														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegex::Compile
+ *
+ *		Parse the regular expression and simplify it. This must be called
+ *	before Strings or Construct.
+ */
+
+void OCLexRegex::Compile(const char *regex)
+{
+	nodes.clear();
+
+	root = Parse(regex);
+	limit = nodes.size();
+	root = Simplify(root);
+}
+
+/*	OCLexRegex::Strings
+ *
+ *		If the expression matches a finite list of non-empty strings, no
+ *	larger than the expression itself, return the list in words. Returns
+ *	false for anything else, including expressions such as [a-z][a-z]
+ *	which would expand to far more text than they are written with.
+ */
+
+bool OCLexRegex::Strings(std::vector<std::string> &words) const
+{
+	words.clear();
+	words.push_back(std::string());
+
+	if (!Expand(root,words)) return false;
+
+	std::vector<std::string>::const_iterator iter;
+	for (iter = words.begin(); iter != words.end(); ++iter) {
+		if (iter->empty()) return false;
+	}
+	return true;
+}
+
+/*	OCLexRegex::Construct
+ *
+ *		Construct the NFA states which represent the compiled expression.
+ *	Returns the start and end states
+ */
+
+OCLexNFAReturn OCLexRegex::Construct(OCLexNFA &nfa)
+{
+	OCLexNFAReturn ret;
+	ret.start = nfa.NewState();
+	ret.end = Emit(nfa,root,ret.start);
+
+	if (ret.end == ret.start) {
+		/*
+		 *	Degenerate case; is empty. Return empty transition. This returns
+		 *
+		 *		START ---e---> END
+		 */
+
+		ret.end = nfa.NewState();
+		nfa.AddEpsilon(ret.start,ret.end);
+	}
+
+	return ret;
+}
+
+/************************************************************************/
+/*																		*/
+/*	Parse regular expression											*/
+/*																		*/
+/************************************************************************/
+
+static int ToHex(char ch)
+{
+	if ((ch >= '0') && (ch <= '9')) return ch - '0';
+	if ((ch >= 'a') && (ch <= 'f')) return ch - 'a' + 10;
+	if ((ch >= 'A') && (ch <= 'F')) return ch - 'A' + 10;
+	return 0;
+}
+
+/**
+ *	Grab the character after a '\', and translate into the appropriate
+ *	escaped character. regex should point to the character after the '\'.
+ */
+
+char OCLexRegex::EscapeCharacter(const char * &regex)
+{
+	char ch = *regex++;
+
+	if (ch == 'a') return 0x07;
+	else if (ch == 'b') return 0x08;
+	else if (ch == 'f') return 0x0C;
+	else if (ch == 'n') return 0x0A;
+	else if (ch == 'r') return 0x0D;
+	else if (ch == 't') return 0x09;
+	else if (ch == 'v') return 0x0B;
+	else if (ch == 'e') return 0x1B;
+	else if ((ch == 'x') || (ch == 'X')) {
+		char ret = 0;
+		while (isxdigit(ch = *regex)) {
+			ret = (ret << 4) | ToHex(ch);
+			++regex;
+		}
+		return ret;
+	} else if ((ch >= '0') && (ch <= '7')) {
+		char ret = ch - '0';
+		while (((ch = *regex) >= '0') && (ch <= '7')) {
+			ret = (ret << 3) | (ch - '0');
+			++regex;
+		}
+		return ret;
+	} else {
+		return ch;
+	}
+}
+
+/*
+ *	Grab the contents of a string
+ */
+
+uint32_t OCLexRegex::ParseString(const char * &regex)
+{
+	std::vector<uint32_t> list;
+
+	++regex;		// skip opening '"'
+	for (;;) {
+		if ((*regex == 0) || (*regex == '"')) break;
+
+		char ch;
+		if (*regex == '\\') {
+			++regex;
+
+			ch = EscapeCharacter(regex);
+		} else {
+			ch = *regex++;
+		}
+
+		OCCharSet set;
+		set.SetCharacter(ch);
+		list.push_back(NewSet(set));
+	}
+
+	if (*regex == '"') ++regex;
+	return NewList(KRegexConcat,list);
+}
+
+/*
+ *	Construct a node representing the character set
+ */
+
+uint32_t OCLexRegex::ParseCharSet(const char * &regex)
+{
+	bool atStart = true;
+	bool invert = false;
+	char lastChar = 0;
+
+	/*
+	 *	Scan forward and set the characters in the character set
+	 */
+
+	OCCharSet set;
+
+	++regex;
+	for (;;) {
+		if (*regex == 0) break;
+		if (!atStart && (*regex == ']')) break;
+
+		if (atStart && (*regex == '^')) {
+			invert = true;
+			++regex;
+		} else if (lastChar && (*regex == '-')) {
+			// Range from last char to next char
+			char nextChar;
+
+			nextChar = *++regex;
+
+			// Fringe case: -], we count the ] as a close. If you want
+			// to run the range to ], insert \] instead.
+			if (nextChar == ']') {
+				atStart = false;
+				lastChar = '-';
+				set.SetCharacter(lastChar);
+				continue;
+			}
+
+			if (nextChar == '\\') {
+				++regex;
+				nextChar = EscapeCharacter(regex);
+			}
+			if (nextChar == 0) break;
+
+			unsigned char startIter = (unsigned char)lastChar;
+			unsigned char endIter = (unsigned char)nextChar;
+			if (startIter > endIter) {
+				startIter = (unsigned char)nextChar;
+				endIter = (unsigned char)lastChar;
+			}
+
+			for (unsigned char i = startIter; i <= endIter; ++i) {
+				set.SetCharacter(i);
+				if (i == 0xFF) break;
+			}
+
+			++regex;
+			lastChar = 0;
+
+		} else if (*regex == '\\') {
+			atStart = false;
+			++regex;
+			lastChar = EscapeCharacter(regex);
+			set.SetCharacter(lastChar);
+
+		} else {
+			// Set character
+
+			atStart = false;
+			lastChar = *regex++;
+			set.SetCharacter(lastChar);
+		}
+	}
+	if (*regex == ']') ++regex;
+
+	if (invert) {
+		set.Invert();
+	}
+
+	return NewSet(set);
+}
+
+/*
+ *	Parse the regular expression of a definition
+ */
+
+uint32_t OCLexRegex::ParseDefinition(const char * &regex)
+{
+	std::string defname;
+
+	++regex;			// skip '{'
+	for (;;) {
+		if ((*regex == 0) || (*regex == '}')) break;
+		defname.push_back(*regex++);
+	}
+
+	if (*regex == '}') ++regex;
+
+	/*
+	 *	Now look up the regular expression for our definition
+	 */
+
+	if (definitions.end() == definitions.find(defname)) {
+		fprintf(stderr,"Definition %s in regular expression not defined\n",defname.c_str());
+
+		/*
+		 *	Return empty sequence
+		 */
+
+		return NewNode(KRegexEmpty);
+	} else {
+		/*
+		 *	Determine if we are already in this definition. If we are, we
+		 *	are in a loop
+		 */
+
+		if (inDefinition.find(defname) != inDefinition.end()) {
+			fprintf(stderr,"Definition %s creates an infinite loop of definitions",defname.c_str());
+			fprintf(stderr,"Fatal. Halting");
+			exit(1);
+		}
+
+
+		/*
+		 *	Recursively parse the embedded regular expression, tracking those
+		 *	definitions we've already hit.
+		 */
+
+		inDefinition.insert(defname);
+
+		const char *str = definitions[defname].c_str();
+		uint32_t ret = Parse(str);
+
+		inDefinition.erase(defname);
+
+		return ret;
+	}
+}
+
+/*	OCLexRegex::Parse
+ *
+ *		Internal parse. This takes a pointer to the regex string; this
+ *	allows me to scan forwards. Parsing stops at the end of the string or
+ *	at an unmatched ')'.
+ */
+
+uint32_t OCLexRegex::Parse(const char * &regex)
+{
+	std::vector<uint32_t> list;
+
+	for (;;) {
+		/*
+		 *	Start reading the string left to right. Parse special
+		 *	characters
+		 */
+
+		if ((*regex == ')') || (*regex == 0)) break;
+
+		/*
+		 *	Handle *, ?, + postfix, which apply to the last item. If there
+		 *	is no last item these are treated as ordinary characters
+		 */
+
+		if (!list.empty() && ((*regex == '*') || (*regex == '+') || (*regex == '?'))) {
+			OCLexRegexType type;
+			if (*regex == '*') type = KRegexStar;
+			else if (*regex == '+') type = KRegexPlus;
+			else type = KRegexOpt;
+
+			uint32_t node = NewNode(type);
+			nodes[node].list.push_back(list.back());
+			list.back() = node;
+
+			++regex;
+			continue;
+		}
+
+		if (*regex == '|') {
+			/*
+			 *	Handle | operator. This recurses the right side, then
+			 *	joins the two sides. Note that this completes this
+			 *	subexpression, so after we handle this, we stop parsing
+			 *	for this level
+			 */
+
+			++regex;
+			uint32_t rhs = Parse(regex);
+
+			if (list.empty()) {
+				/*
+				 *	Degenerate case: naked '|'. Turn the following into
+				 *	the same as (xxx)?
+				 */
+
+				uint32_t node = NewNode(KRegexOpt);
+				nodes[node].list.push_back(rhs);
+				return node;
+			}
+
+			std::vector<uint32_t> alt;
+			alt.push_back(NewList(KRegexConcat,list));
+			alt.push_back(rhs);
+			return NewList(KRegexAlt,alt);
+		}
+
+		/*
+		 *	Handle subexpression
+		 */
+
+		uint32_t item;
+		if (*regex == '(') {
+			++regex;
+			item = Parse(regex);
+			if (*regex == ')') ++regex;	// skip end
+
+		} else if (*regex == '\"') {
+			item = ParseString(regex);
+
+		} else if (*regex == '[') {
+			item = ParseCharSet(regex);
+
+		} else if (*regex == '{') {
+			item = ParseDefinition(regex);
+
+		} else {
+			/*
+			 *	At this point we're simply adding the following character
+			 */
+
+			OCCharSet set;
+			if (*regex == '\\') {
+				++regex;			// skip and escape next character
+				set.SetCharacter(EscapeCharacter(regex));
+			} else if (*regex == '.') {
+				set.Invert();		// any character
+				++regex;
+			} else {
+				set.SetCharacter(*regex++);
+			}
+
+			item = NewSet(set);
+		}
+
+		list.push_back(item);
+	}
+
+	return NewList(KRegexConcat,list);
+}
+
+/************************************************************************/
+/*																		*/
+/*	Tree Support														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegex::NewNode
+ *
+ *		Allocate a new node. Note this may move the nodes in memory, so
+ *	references to nodes must not be held across calls
+ */
+
+uint32_t OCLexRegex::NewNode(OCLexRegexType type)
+{
+	uint32_t index = (uint32_t)nodes.size();
+
+	nodes.push_back(OCLexRegexNode());
+	nodes[index].type = type;
+
+	return index;
+}
+
+uint32_t OCLexRegex::NewSet(const OCCharSet &set)
+{
+	uint32_t index = NewNode(KRegexSet);
+	nodes[index].set = set;
+	return index;
+}
+
+uint32_t OCLexRegex::NewList(OCLexRegexType type, const std::vector<uint32_t> &list)
+{
+	uint32_t index = NewNode(type);
+	nodes[index].list = list;
+	return index;
+}
+
+/*	OCLexRegex::NewRepeat
+ *
+ *		Wrap the node in a *, + or ? operator, collapsing repeats of
+ *	repeats. x** and x+* are x*, (x?)* and (x*)? are x*, and so on.
+ */
+
+uint32_t OCLexRegex::NewRepeat(OCLexRegexType type, uint32_t node)
+{
+	OCLexRegexType inner = nodes[node].type;
+
+	if ((inner == KRegexEmpty) || (inner == KRegexStar)) return node;
+	if ((inner == KRegexPlus) || (inner == KRegexOpt)) {
+		if (inner == type) return node;
+
+		/*
+		 *	Mixing + and ? in any order gives *
+		 */
+
+		type = KRegexStar;
+		node = nodes[node].list[0];
+	}
+
+	uint32_t index = NewNode(type);
+	nodes[index].list.push_back(node);
+	return index;
+}
+
+/*	OCLexRegex::Equal
+ *
+ *		Returns true if the two trees are the same
+ */
+
+bool OCLexRegex::Equal(uint32_t a, uint32_t b) const
+{
+	if (a == b) return true;
+
+	const OCLexRegexNode &na = nodes[a];
+	const OCLexRegexNode &nb = nodes[b];
+
+	if (na.type != nb.type) return false;
+	if (na.type == KRegexSet) return na.set == nb.set;
+	if (na.list.size() != nb.list.size()) return false;
+
+	size_t i,len = na.list.size();
+	for (i = 0; i < len; ++i) {
+		if (!Equal(na.list[i],nb.list[i])) return false;
+	}
+	return true;
+}
+
+/*	OCLexRegex::First
+ *
+ *		Return the first item of a sequence. Anything other than a
+ *	sequence is a sequence of one item
+ */
+
+uint32_t OCLexRegex::First(uint32_t node) const
+{
+	if (nodes[node].type == KRegexConcat) return nodes[node].list[0];
+	return node;
+}
+
+/*	OCLexRegex::Rest
+ *
+ *		Return the sequence without its first item
+ */
+
+uint32_t OCLexRegex::Rest(uint32_t node)
+{
+	if (nodes[node].type != KRegexConcat) return NewNode(KRegexEmpty);
+
+	std::vector<uint32_t> list(nodes[node].list.begin() + 1,nodes[node].list.end());
+	if (list.size() == 1) return list[0];
+	return NewList(KRegexConcat,list);
+}
+
+/************************************************************************/
+/*																		*/
+/*	Simplification														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegex::Simplify
+ *
+ *		Simplify the tree. This returns the index of the simplified tree,
+ *	which may be a new node. After simplification sequences and
+ *	alternations have at least two items, are not nested directly within
+ *	nodes of the same type, and contain no empty nodes.
+ */
+
+uint32_t OCLexRegex::Simplify(uint32_t node)
+{
+	OCLexRegexType type = nodes[node].type;
+
+	switch (type) {
+		case KRegexEmpty:
+		case KRegexSet:
+			return node;
+
+		case KRegexConcat:
+			return SimplifyConcat(node);
+
+		case KRegexAlt:
+			return SimplifyAlt(node);
+
+		default:
+			return NewRepeat(type,Simplify(nodes[node].list[0]));
+	}
+}
+
+/*	OCLexRegex::SimplifyConcat
+ *
+ *		Simplify a sequence, dropping empty items and flattening nested
+ *	sequences
+ */
+
+uint32_t OCLexRegex::SimplifyConcat(uint32_t node)
+{
+	std::vector<uint32_t> list = nodes[node].list;
+	std::vector<uint32_t> items;
+
+	std::vector<uint32_t>::iterator iter;
+	for (iter = list.begin(); iter != list.end(); ++iter) {
+		uint32_t item = Simplify(*iter);
+
+		OCLexRegexType type = nodes[item].type;
+		if (type == KRegexEmpty) continue;
+		if (type == KRegexConcat) {
+			items.insert(items.end(),nodes[item].list.begin(),nodes[item].list.end());
+		} else {
+			items.push_back(item);
+		}
+	}
+
+	if (items.empty()) return NewNode(KRegexEmpty);
+	if (items.size() == 1) return items[0];
+	return NewList(KRegexConcat,items);
+}
+
+/*	OCLexRegex::SimplifyAlt
+ *
+ *		Simplify an alternation
+ */
+
+uint32_t OCLexRegex::SimplifyAlt(uint32_t node)
+{
+	std::vector<uint32_t> list = nodes[node].list;
+
+	std::vector<uint32_t>::iterator iter;
+	for (iter = list.begin(); iter != list.end(); ++iter) {
+		*iter = Simplify(*iter);
+	}
+
+	return JoinAlt(list);
+}
+
+/*	OCLexRegex::JoinAlt
+ *
+ *		Construct the alternation of a list of simplified nodes. Nested
+ *	alternations are flattened, and an empty alternative (or an optional
+ *	one) makes the whole alternation optional. Alternatives which start
+ *	with the same item are factored, and alternatives which are a single
+ *	character set are merged.
+ */
+
+uint32_t OCLexRegex::JoinAlt(const std::vector<uint32_t> &list)
+{
+	std::vector<uint32_t> alts;
+	bool empty = false;
+
+	std::vector<uint32_t>::const_iterator iter;
+	for (iter = list.begin(); iter != list.end(); ++iter) {
+		uint32_t item = *iter;
+
+		OCLexRegexType type = nodes[item].type;
+		if (type == KRegexEmpty) {
+			empty = true;
+			continue;
+		}
+		if (type == KRegexOpt) {
+			// x?|y is the same as x|y|(empty)
+			empty = true;
+			item = nodes[item].list[0];
+			type = nodes[item].type;
+		}
+		if (type == KRegexAlt) {
+			alts.insert(alts.end(),nodes[item].list.begin(),nodes[item].list.end());
+		} else {
+			alts.push_back(item);
+		}
+	}
+
+	Factor(alts);
+
+	/*
+	 *	Merge the single character alternatives into one set, placed
+	 *	where the first one was
+	 */
+
+	std::vector<uint32_t> items;
+	OCCharSet merged;
+	size_t setPos = 0;
+	uint32_t setCount = 0;
+	for (iter = alts.begin(); iter != alts.end(); ++iter) {
+		if (nodes[*iter].type == KRegexSet) {
+			if (setCount++ == 0) {
+				setPos = items.size();
+				items.push_back(*iter);
+			}
+			merged |= nodes[*iter].set;
+		} else {
+			items.push_back(*iter);
+		}
+	}
+	if (setCount > 1) {
+		items[setPos] = NewSet(merged);
+	}
+
+	/*
+	 *	Construct the result
+	 */
+
+	uint32_t ret;
+	if (items.empty()) {
+		return NewNode(KRegexEmpty);
+	} else if (items.size() == 1) {
+		ret = items[0];
+	} else {
+		ret = NewList(KRegexAlt,items);
+	}
+
+	if (empty) ret = NewRepeat(KRegexOpt,ret);
+	return ret;
+}
+
+/*	OCLexRegex::Factor
+ *
+ *		Factor the common first item out of alternatives, so "if"|"int"
+ *	becomes i("f"|"nt"). Alternatives are grouped by their first item in
+ *	the order each is first seen; the remainders of each group with more
+ *	than one member are joined as an alternation in their own right,
+ *	which factors them in turn.
+ */
+
+void OCLexRegex::Factor(std::vector<uint32_t> &alts)
+{
+	std::vector<std::vector<size_t> > groups;
+	std::map<OCCharSet,size_t> setGroup;
+	std::vector<size_t> otherGroup;
+
+	/*
+	 *	Group the alternatives. The first item is almost always a
+	 *	character set, so those are found through a map.
+	 */
+
+	size_t i,len = alts.size();
+	for (i = 0; i < len; ++i) {
+		uint32_t first = First(alts[i]);
+		size_t g = groups.size();
+
+		if (nodes[first].type == KRegexSet) {
+			std::map<OCCharSet,size_t>::iterator f = setGroup.find(nodes[first].set);
+			if (f == setGroup.end()) {
+				setGroup[nodes[first].set] = g;
+			} else {
+				g = f->second;
+			}
+		} else {
+			std::vector<size_t>::iterator o;
+			for (o = otherGroup.begin(); o != otherGroup.end(); ++o) {
+				if (Equal(First(alts[groups[*o][0]]),first)) {
+					g = *o;
+					break;
+				}
+			}
+			if (g == groups.size()) otherGroup.push_back(g);
+		}
+
+		if (g == groups.size()) groups.push_back(std::vector<size_t>());
+		groups[g].push_back(i);
+	}
+
+	if (groups.size() == len) return;		// nothing in common
+
+	/*
+	 *	Now construct first(rest|rest...) for each group
+	 */
+
+	std::vector<uint32_t> ret;
+	std::vector<std::vector<size_t> >::iterator giter;
+	for (giter = groups.begin(); giter != groups.end(); ++giter) {
+		if (giter->size() == 1) {
+			ret.push_back(alts[(*giter)[0]]);
+			continue;
+		}
+
+		uint32_t first = First(alts[(*giter)[0]]);
+
+		std::vector<uint32_t> rest;
+		std::vector<size_t>::iterator iter;
+		for (iter = giter->begin(); iter != giter->end(); ++iter) {
+			rest.push_back(Rest(alts[*iter]));
+		}
+		uint32_t tail = JoinAlt(rest);
+
+		std::vector<uint32_t> seq;
+		seq.push_back(first);
+		if (nodes[tail].type == KRegexConcat) {
+			seq.insert(seq.end(),nodes[tail].list.begin(),nodes[tail].list.end());
+		} else if (nodes[tail].type != KRegexEmpty) {
+			seq.push_back(tail);
+		}
+
+		ret.push_back((seq.size() == 1) ? seq[0] : NewList(KRegexConcat,seq));
+	}
+
+	alts = ret;
+}
+
+/************************************************************************/
+/*																		*/
+/*	String Expansion													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegex::Expand
+ *
+ *		Append each string matched by the node to each of the strings in
+ *	words. Returns false if the node matches an unbounded number of
+ *	strings, or if the list grows larger than the expression it came from.
+ */
+
+bool OCLexRegex::Expand(uint32_t node, std::vector<std::string> &words) const
+{
+	const OCLexRegexNode &n = nodes[node];
+	std::vector<std::string> ret;
+	size_t size = 0;
+
+	switch (n.type) {
+		default:
+			return false;
+
+		case KRegexEmpty:
+			return true;
+
+		case KRegexSet: {
+			size_t count = n.set.Count();
+
+			std::vector<std::string>::iterator iter;
+			for (iter = words.begin(); iter != words.end(); ++iter) {
+				size += (iter->size() + 1) * count;
+			}
+			if (size > limit) return false;
+
+			/*
+			 *	The common case is a single character, which we can simply
+			 *	append to each string
+			 */
+
+			if (count == 1) {
+				char ch = (char)n.set.First();
+				for (iter = words.begin(); iter != words.end(); ++iter) {
+					iter->push_back(ch);
+				}
+				return true;
+			}
+
+			for (iter = words.begin(); iter != words.end(); ++iter) {
+				for (int c = 0; c < 256; ++c) {
+					if (!n.set.TestCharacter((unsigned char)c)) continue;
+
+					ret.push_back(*iter);
+					ret.back().push_back((char)c);
+				}
+			}
+			break;
+		}
+
+		case KRegexConcat: {
+			std::vector<uint32_t>::const_iterator iter;
+			for (iter = n.list.begin(); iter != n.list.end(); ++iter) {
+				if (!Expand(*iter,words)) return false;
+			}
+			return true;
+		}
+
+		case KRegexAlt:
+		case KRegexOpt: {
+			if (n.type == KRegexOpt) ret = words;
+
+			std::vector<uint32_t>::const_iterator iter;
+			for (iter = n.list.begin(); iter != n.list.end(); ++iter) {
+				std::vector<std::string> alt = words;
+				if (!Expand(*iter,alt)) return false;
+				ret.insert(ret.end(),alt.begin(),alt.end());
+			}
+
+			std::vector<std::string>::const_iterator witer;
+			for (witer = ret.begin(); witer != ret.end(); ++witer) {
+				size += witer->size();
+			}
+			if (size > limit) return false;
+			break;
+		}
+	}
+
+	words.swap(ret);
+	return true;
+}
+
+/************************************************************************/
+/*																		*/
+/*	NFA Construction													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegex::Emit
+ *
+ *		Construct the NFA states for the node, starting from the state
+ *	provided, and return the end state. The from state may be shared with
+ *	other parts of the NFA, so we only ever add transitions out of it;
+ *	repeats get a state of their own to loop back to. Likewise callers
+ *	only add transitions out of the end state we return.
+ */
+
+uint32_t OCLexRegex::Emit(OCLexNFA &nfa, uint32_t node, uint32_t from)
+{
+	const OCLexRegexNode &n = nodes[node];
+
+	switch (n.type) {
+		default:
+		case KRegexEmpty:
+			return from;
+
+		case KRegexSet: {
+			uint32_t end = nfa.NewState();
+			nfa.AddTransition(from,end,n.set);
+			return end;
+		}
+
+		case KRegexConcat: {
+			std::vector<uint32_t>::const_iterator iter;
+			for (iter = n.list.begin(); iter != n.list.end(); ++iter) {
+				from = Emit(nfa,*iter,from);
+			}
+			return from;
+		}
+
+		case KRegexAlt: {
+			uint32_t end = nfa.NewState();
+			std::vector<uint32_t>::const_iterator iter;
+			for (iter = n.list.begin(); iter != n.list.end(); ++iter) {
+				if (nodes[*iter].type == KRegexSet) {
+					nfa.AddTransition(from,end,nodes[*iter].set);
+				} else {
+					nfa.AddEpsilon(Emit(nfa,*iter,from),end);
+				}
+			}
+			return end;
+		}
+
+		case KRegexStar: {
+			/*
+			 *	START ---e---> LOOP, with x looping back to LOOP, which
+			 *	is our end state
+			 */
+
+			uint32_t loop = nfa.NewState();
+			nfa.AddEpsilon(from,loop);
+
+			uint32_t child = n.list[0];
+			if (nodes[child].type == KRegexSet) {
+				nfa.AddTransition(loop,loop,nodes[child].set);
+			} else {
+				uint32_t end = Emit(nfa,child,loop);
+				if (end != loop) nfa.AddEpsilon(end,loop);
+			}
+			return loop;
+		}
+
+		case KRegexPlus: {
+			uint32_t child = n.list[0];
+			if (nodes[child].type == KRegexSet) {
+				uint32_t end = nfa.NewState();
+				nfa.AddTransition(from,end,nodes[child].set);
+				nfa.AddTransition(end,end,nodes[child].set);
+				return end;
+			}
+
+			uint32_t loop = nfa.NewState();
+			nfa.AddEpsilon(from,loop);
+
+			uint32_t end = Emit(nfa,child,loop);
+			if (end != loop) nfa.AddEpsilon(end,loop);
+			return end;
+		}
+
+		case KRegexOpt: {
+			uint32_t end = Emit(nfa,n.list[0],from);
+			if (end == from) return from;
+
+			uint32_t skip = nfa.NewState();
+			nfa.AddEpsilon(from,skip);
+			nfa.AddEpsilon(end,skip);
+			return skip;
+		}
+	}
+}
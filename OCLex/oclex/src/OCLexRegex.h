@@ -0,0 +1,141 @@
+//
+//  OCLexRegex.h
+//  oclex
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef OCLexRegex_h
+#define OCLexRegex_h
+
+#include "OCCharSet.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class OCLexNFA;
+struct OCLexNFAReturn;
+
+/************************************************************************/
+/*																		*/
+/*	Regular Expression Tree												*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexRegexType
+ *
+ *		The types of nodes in a parsed regular expression
+ */
+
+enum OCLexRegexType
+{
+	KRegexEmpty,			// matches the empty string
+	KRegexSet,				// matches one character in set
+	KRegexConcat,			// matches each item of list in turn
+	KRegexAlt,				// matches any one item of list
+	KRegexStar,				// 0..N of list[0]
+	KRegexPlus,				// 1..N of list[0]
+	KRegexOpt				// 0..1 of list[0]
+};
+
+/*	OCLexRegexNode
+ *
+ *		A node in the regular expression tree. Children are referred to by
+ *	their index in the tree's node list
+ */
+
+struct OCLexRegexNode
+{
+	OCLexRegexType			type;
+	OCCharSet				set;
+	std::vector<uint32_t>	list;
+};
+
+/*	OCLexRegex
+ *
+ *		Parses a lex regular expression into a tree, simplifies the tree,
+ *	then builds the equivalent NFA states using Thompson's construction.
+ *	Simplifying first means alternations such as "if"|"int" share their
+ *	common prefix, single character alternatives become one character
+ *	set, and redundant repeats such as x** are collapsed, so the NFA we
+ *	build is smaller.
+ *
+ *		An expression which only matches a short list of literal strings
+ *	can instead be returned as that list of strings.
+ */
+
+class OCLexRegex
+{
+	public:
+		OCLexRegex(std::map<std::string,std::string> &defn) : definitions(defn)
+			{
+				root = 0;
+				limit = 0;
+			}
+
+		~OCLexRegex()
+			{
+			}
+
+		void Compile(const char *regex);
+		bool Strings(std::vector<std::string> &words) const;
+		OCLexNFAReturn Construct(OCLexNFA &nfa);
+
+	private:
+		std::map<std::string,std::string> &definitions;
+		std::set<std::string> inDefinition;
+		std::vector<OCLexRegexNode> nodes;
+		uint32_t root;						// compiled expression
+		size_t limit;						// size of the parsed tree
+
+		/*
+		 *	Parsing
+		 */
+
+		uint32_t Parse(const char *&regex);
+		char EscapeCharacter(const char *&regex);
+
+		uint32_t ParseString(const char *&regex);
+		uint32_t ParseCharSet(const char *&regex);
+		uint32_t ParseDefinition(const char *&regex);
+
+		/*
+		 *	Tree support
+		 */
+
+		uint32_t NewNode(OCLexRegexType type);
+		uint32_t NewSet(const OCCharSet &set);
+		uint32_t NewList(OCLexRegexType type, const std::vector<uint32_t> &list);
+		uint32_t NewRepeat(OCLexRegexType type, uint32_t node);
+
+		bool Equal(uint32_t a, uint32_t b) const;
+		uint32_t First(uint32_t node) const;
+		uint32_t Rest(uint32_t node);
+
+		/*
+		 *	Simplification
+		 */
+
+		uint32_t Simplify(uint32_t node);
+		uint32_t SimplifyConcat(uint32_t node);
+		uint32_t SimplifyAlt(uint32_t node);
+		uint32_t JoinAlt(const std::vector<uint32_t> &list);
+		void Factor(std::vector<uint32_t> &alts);
+
+		/*
+		 *	String expansion
+		 */
+
+		bool Expand(uint32_t node, std::vector<std::string> &words) const;
+
+		/*
+		 *	NFA construction
+		 */
+
+		uint32_t Emit(OCLexNFA &nfa, uint32_t node, uint32_t from);
+};
+
+#endif /* OCLexRegex_h */
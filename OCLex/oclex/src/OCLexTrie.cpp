@@ -0,0 +1,276 @@
+//
+//  OCLexTrie.cpp
+//  oclex
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include "OCLexTrie.h"
+#include "OCLexNFA.h"
+
+#include <algorithm>
+
+/************************************************************************/
+/*																		*/
+/*	Gather strings														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexTrie::AddString
+ *
+ *		Add a string matched by the rule provided. Empty strings are not
+ *	handled here; they are left to the NFA.
+ */
+
+void OCLexTrie::AddString(const std::string &str, uint32_t rule, bool unconditional)
+{
+	if (str.empty()) return;
+
+	Word w;
+	w.str = str;
+	w.rule = rule;
+	w.unconditional = unconditional;
+	words.push_back(w);
+}
+
+/************************************************************************/
+/*																		*/
+/*	Construction														*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexTrie::NewState
+ *
+ *		Allocate a new state, reusing a freed state if we have one
+ */
+
+uint32_t OCLexTrie::NewState()
+{
+	if (!freeList.empty()) {
+		uint32_t state = freeList.back();
+		freeList.pop_back();
+		return state;
+	}
+
+	states.push_back(State());
+	return (uint32_t)(states.size() - 1);
+}
+
+/*	OCLexTrie::Signature
+ *
+ *		Two states are equivalent if they end the same rules and have the
+ *	same transitions to the same states. This builds a string which
+ *	represents that, for use as the key in the register.
+ */
+
+std::string OCLexTrie::Signature(uint32_t state) const
+{
+	const State &s = states[state];
+	std::string ret;
+
+	uint32_t len = (uint32_t)s.rules.size();
+	ret.append((const char *)&len,sizeof(len));
+	ret.append((const char *)s.rules.data(),len * sizeof(uint32_t));
+
+	std::vector<Edge>::const_iterator iter;
+	for (iter = s.edges.begin(); iter != s.edges.end(); ++iter) {
+		ret.push_back((char)iter->ch);
+		ret.append((const char *)&iter->state,sizeof(iter->state));
+	}
+	return ret;
+}
+
+/*	OCLexTrie::Minimize
+ *
+ *		The path holds the states along the last string added, with the
+ *	start state first. Every state past depth is now complete, as the
+ *	strings which follow in sorted order cannot add to them. Working back
+ *	from the end, replace each with an equivalent state from the register
+ *	or register it, then trim the path to depth.
+ *
+ *		As we work backwards, the states a state transitions to have
+ *	already been replaced, so comparing transitions by state index is
+ *	enough to find equivalent states.
+ */
+
+void OCLexTrie::Minimize(std::vector<uint32_t> &path, size_t depth)
+{
+	while (path.size() > depth + 1) {
+		uint32_t child = path.back();
+		path.pop_back();
+
+		std::string key = Signature(child);
+		std::unordered_map<std::string,uint32_t>::iterator f = stateRegister.find(key);
+		if (f == stateRegister.end()) {
+			stateRegister[key] = child;
+		} else {
+			states[path.back()].edges.back().state = f->second;
+
+			states[child].edges.clear();
+			states[child].rules.clear();
+			freeList.push_back(child);
+		}
+	}
+}
+
+/*	OCLexTrie::Construct
+ *
+ *		Build the minimal automaton for the strings we've gathered, add it
+ *	to the NFA and return its start state. The list of strings is cleared.
+ */
+
+uint32_t OCLexTrie::Construct(OCLexNFA &nfa)
+{
+	/*
+	 *	Sort the strings. Duplicates are adjacent, ordered by rule.
+	 */
+
+	std::sort(words.begin(),words.end(),[](const Word &a, const Word &b) {
+		int r = a.str.compare(b.str);
+		if (r != 0) return r < 0;
+		return a.rule < b.rule;
+	});
+
+	states.clear();
+	freeList.clear();
+	stateRegister.clear();
+
+	std::vector<uint32_t> path;
+	path.push_back(NewState());
+
+	const std::string empty;
+	const std::string *last = &empty;
+
+	size_t i = 0,len = words.size();
+	while (i < len) {
+		const std::string &str = words[i].str;
+
+		/*
+		 *	Find the rules which end with this string. As in the DFA, the
+		 *	first unconditional rule hides all the rules after it.
+		 */
+
+		std::vector<uint32_t> rules;
+		bool hidden = false;
+		for (; (i < len) && (words[i].str == str); ++i) {
+			if (hidden) continue;
+			if (!rules.empty() && (rules.back() == words[i].rule)) continue;
+
+			rules.push_back(words[i].rule);
+			hidden = words[i].unconditional;
+		}
+
+		/*
+		 *	The states past the prefix shared with the last string are
+		 *	complete; minimize them, then add the rest of this string.
+		 */
+
+		size_t prefix = 0;
+		size_t max = std::min(str.size(),last->size());
+		while ((prefix < max) && (str[prefix] == (*last)[prefix])) ++prefix;
+
+		Minimize(path,prefix);
+
+		for (size_t j = prefix; j < str.size(); ++j) {
+			uint32_t state = NewState();
+
+			Edge e;
+			e.ch = (unsigned char)str[j];
+			e.state = state;
+			states[path.back()].edges.push_back(e);
+			path.push_back(state);
+		}
+		states[path.back()].rules = rules;
+
+		last = &str;
+	}
+	Minimize(path,0);
+
+	uint32_t start = Emit(nfa);
+
+	words.clear();
+	states.clear();
+	freeList.clear();
+	stateRegister.clear();
+
+	return start;
+}
+
+/************************************************************************/
+/*																		*/
+/*	NFA Construction													*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexTrie::Emit
+ *
+ *		Add the states reachable from the start state to the NFA, and
+ *	return the NFA start state. Transitions from a state to the same state
+ *	are merged into a single character set.
+ *
+ *		A final state ends the first of its rules. If it ends more than one
+ *	rule, which happens when the first is conditional, it has an empty
+ *	transition to a state for each of the others.
+ */
+
+uint32_t OCLexTrie::Emit(OCLexNFA &nfa)
+{
+	std::vector<uint32_t> nfaState(states.size(),NFA_NOEND);
+	std::map<uint32_t,uint32_t> ruleState;
+
+	std::vector<uint32_t> queue;
+	queue.push_back(0);
+	nfaState[0] = nfa.NewState();
+
+	for (size_t q = 0; q < queue.size(); ++q) {
+		const State &s = states[queue[q]];
+		uint32_t from = nfaState[queue[q]];
+
+		/*
+		 *	Rules
+		 */
+
+		size_t i,len = s.rules.size();
+		if (len != 0) nfa.endRule[from] = s.rules[0];
+		for (i = 1; i < len; ++i) {
+			std::map<uint32_t,uint32_t>::iterator f = ruleState.find(s.rules[i]);
+			if (f == ruleState.end()) {
+				uint32_t state = nfa.NewState();
+				nfa.endRule[state] = s.rules[i];
+				f = ruleState.insert(std::make_pair(s.rules[i],state)).first;
+			}
+			nfa.AddEpsilon(from,f->second);
+		}
+
+		/*
+		 *	Transitions, grouped by the state they go to
+		 */
+
+		std::vector<uint32_t> targets;
+		std::vector<OCCharSet> sets;
+		std::vector<Edge>::const_iterator iter;
+		for (iter = s.edges.begin(); iter != s.edges.end(); ++iter) {
+			if (nfaState[iter->state] == NFA_NOEND) {
+				nfaState[iter->state] = nfa.NewState();
+				queue.push_back(iter->state);
+			}
+
+			uint32_t to = nfaState[iter->state];
+			for (i = 0; i < targets.size(); ++i) {
+				if (targets[i] == to) break;
+			}
+			if (i == targets.size()) {
+				targets.push_back(to);
+				sets.push_back(OCCharSet());
+			}
+			sets[i].SetCharacter(iter->ch);
+		}
+
+		for (i = 0; i < targets.size(); ++i) {
+			nfa.AddTransition(from,targets[i],sets[i]);
+		}
+	}
+
+	return nfaState[0];
+}
@@ -0,0 +1,102 @@
+//
+//  OCLexTrie.h
+//  oclex
+//
+//  Created by agent on 10/17/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef OCLexTrie_h
+#define OCLexTrie_h
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class OCLexNFA;
+
+/************************************************************************/
+/*																		*/
+/*	Literal String Automaton											*/
+/*																		*/
+/************************************************************************/
+
+/*	OCLexTrie
+ *
+ *		Gathers the literal strings matched by rules such as "while" or
+ *	"if"|"int", and builds the minimal deterministic automaton which
+ *	matches them. The automaton is built directly from the sorted list of
+ *	strings, minimizing as each string is added, using the algorithm in:
+ *
+ *		Daciuk, Mihov, Watson and Watson, "Incremental Construction of
+ *		Minimal Acyclic Finite-State Automata", Computational Linguistics
+ *		26(1), 2000.
+ *
+ *	so the work done is proportional to the total length of the strings.
+ *	Common prefixes and common suffixes are shared. Each final state is
+ *	labeled with the rules which end there.
+ *
+ *		The result is added to the NFA as a set of states with a single
+ *	start state; as it is already deterministic, the powerset construction
+ *	never has more than one of its states in a DFA state.
+ */
+
+class OCLexTrie
+{
+	public:
+		OCLexTrie()
+			{
+			}
+
+		~OCLexTrie()
+			{
+			}
+
+		void AddString(const std::string &str, uint32_t rule, bool unconditional);
+
+		size_t Size() const
+			{
+				return words.size();
+			}
+
+		uint32_t Construct(OCLexNFA &nfa);
+
+	private:
+		struct Word {
+			std::string str;
+			uint32_t rule;
+			bool unconditional;
+		};
+
+		struct Edge {
+			unsigned char ch;
+			uint32_t state;
+		};
+
+		struct State {
+			std::vector<Edge> edges;			// ascending by character
+			std::vector<uint32_t> rules;		// rules ending here
+		};
+
+		std::vector<Word> words;
+
+		/*
+		 *	Automaton under construction. States which are merged with an
+		 *	equivalent state are put on the free list for reuse. The
+		 *	register maps the signature of each minimized state to the state.
+		 */
+
+		std::vector<State> states;
+		std::vector<uint32_t> freeList;
+		std::unordered_map<std::string,uint32_t> stateRegister;
+
+		uint32_t NewState();
+		std::string Signature(uint32_t state) const;
+		void Minimize(std::vector<uint32_t> &path, size_t depth);
+		uint32_t Emit(OCLexNFA &nfa);
+};
+
+#endif /* OCLexTrie_h */
@@ -7,11 +7,16 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "OCLexParser.h"
 #include "OCLexGenerator.h"
 #include "OCLexCPPGenerator.h"
 #include "OCLexSwiftGenerator.h"
+#include <OCUtilities.h>
 
 static const char *GHelp =
 	"oclex\n"                                                                 \
@@ -20,11 +25,47 @@ static const char *GHelp =
 	"fast pattern matching on text. This tool takes an input grammar which is \n" \
 	"similar to lex or flex, but generates a re-entrant Objective-C class.\n" \
 	"\n"                                                                      \
-	"Usage: oclex [-h] [-l [oc|c++]] [-o filename] [-c classname] inputfile\n" \
+	"Usage: oclex [-h] [-v] [-j threads] [-s states]\n" \
+	"       [-t [auto|comb|dense|byte|code|pair]] [-b bytes] [-e] [-n] [-d]\n" \
+	"       [-p path] [-l [oc|c++]] [-o filename] [-c classname] inputfile\n" \
 	"\n"                                                                      \
 	"-h  Prints this help file. This help file will also be printed if any illegal\n" \
 	"    parameters are provided. \n"                                         \
 	"\n"                                                                      \
+	"-v  Verbose. Prints the number of NFA and DFA states (before and after\n" \
+	"    minimization) and the number of character classes generated.\n"    \
+	"\n"                                                                      \
+	"-j  Number of threads used to build the DFA. The output does not depend on\n" \
+	"    the number of threads. Defaults to 1.\n"                            \
+	"\n"                                                                      \
+	"-s  Maximum number of DFA states to build in advance (C++ only). If the DFA\n" \
+	"    has more states, the lexer builds the states it needs as it runs, keeping\n" \
+	"    up to this many in a cache. By default the full DFA is always built.\n" \
+	"\n"                                                                      \
+	"-t  State table format (C++ only). comb writes a compressed table, dense\n" \
+	"    a full table of states by character classes, and byte a full table of\n" \
+	"    states by characters. code writes no table; each state is written as\n" \
+	"    code which jumps to the next. pair adds a table for two characters at\n" \
+	"    a time to a dense table, if both fit within the budget given by -b.\n" \
+	"    auto, the default, writes a dense table if it fits within the budget,\n" \
+	"    and a compressed table otherwise.\n"                                 \
+	"\n"                                                                      \
+	"-b  Size budget in bytes for -t auto and -t pair. Defaults to 65536.\n"  \
+	"\n"                                                                      \
+	"-e  Write the tables as one string of bytes rather than lists of numbers\n" \
+	"    (C++ only). Large lexers compile much faster.\n"                     \
+	"\n"                                                                      \
+	"-n  Do not copy each token into text (C++ only). Actions read the token in\n" \
+	"    place with textData() and textLength(), or textView() in C++17.\n"   \
+	"\n"                                                                      \
+	"-d  Defer line and column (C++ only). The lexer only keeps the offset of\n" \
+	"    each token, tokenOffset(), and position() finds its line and column\n" \
+	"    when asked. line and column are not set as it reads.\n"              \
+	"\n"                                                                      \
+	"-p  Profile the DFA over sample input: a file, or a directory of files.\n" \
+	"    The states and character classes used most are numbered first, so\n" \
+	"    the tables they use sit together in memory.\n"                       \
+	"\n"                                                                      \
 	"-l  Select language. Arguments are oc for Objective-C and c++ for C++. If\n" \
 	"    not provided, uses Objective-C as default.\n"                        \
 	"\n"                                                                      \
@@ -68,6 +109,15 @@ static char GOutputFileName[FILENAME_MAX];
 static char GInputFile[FILENAME_MAX];
 static char GClassName[FILENAME_MAX];
 static LanguageEnum GLanguage = KLanguageOP;
+static bool GVerbose = false;
+static uint32_t GThreads = 1;
+static uint32_t GMaxStates = 0;
+static OCLexTableEnum GTableFormat = KTableAuto;
+static size_t GTableBudget = 65536;
+static const char *GProfilePath = NULL;
+static bool GTableBlob = false;
+static bool GCopyText = true;
+static bool GTrackLines = true;
 
 /*	PrintHelp
  *
@@ -104,6 +154,15 @@ static void PrintError(int argc, const char *argv[])
  *		The parameters we accept are:
  *
  *		-h			Help
+ *		-v			Verbose; print state statistics
+ *		-j threads	Number of threads used to build the DFA
+ *		-s states	Maximum DFA states before building lazily (C++)
+ *		-t format	State table format (C++)
+ *		-b bytes	Table budget for -t auto and -t pair (C++)
+ *		-e			Write the tables as a blob (C++)
+ *		-n			Do not copy tokens into text (C++)
+ *		-d			Defer line and column to when asked (C++)
+ *		-p path		Sample input to order the DFA by
  *		-c class	Output class name (default is input file name)
  *		-o file		Output file name (default is input file name)
  *		input		Input file name
@@ -122,6 +181,66 @@ static void ParseArgs(int argc, const char *argv[])
 		if (*ptr == '-') {
 			if (!strcmp(ptr,"-h")) {
 				PrintHelp();
+			} else if (!strcmp(ptr,"-v")) {
+				GVerbose = true;
+			} else if (!strcmp(ptr,"-j")) {
+				if (i >= argc) {
+					PrintError(argc,argv);
+				}
+				long n;
+				if (!OCParseNumber(argv[i++],1,INT_MAX,n)) {
+					PrintError(argc,argv);
+				}
+				GThreads = (uint32_t)n;
+			} else if (!strcmp(ptr,"-s")) {
+				if (i >= argc) {
+					PrintError(argc,argv);
+				}
+				long n;
+				if (!OCParseNumber(argv[i++],1,INT_MAX,n)) {
+					PrintError(argc,argv);
+				}
+				GMaxStates = (uint32_t)n;
+			} else if (!strcmp(ptr,"-t")) {
+				if (i >= argc) {
+					PrintError(argc,argv);
+				}
+				ptr = argv[i++];
+				if (!strcmp(ptr,"auto")) {
+					GTableFormat = KTableAuto;
+				} else if (!strcmp(ptr,"comb")) {
+					GTableFormat = KTableCompressed;
+				} else if (!strcmp(ptr,"dense")) {
+					GTableFormat = KTableDense;
+				} else if (!strcmp(ptr,"byte")) {
+					GTableFormat = KTableByte;
+				} else if (!strcmp(ptr,"code")) {
+					GTableFormat = KTableCode;
+				} else if (!strcmp(ptr,"pair")) {
+					GTableFormat = KTablePair;
+				} else {
+					PrintError(argc,argv);
+				}
+			} else if (!strcmp(ptr,"-b")) {
+				if (i >= argc) {
+					PrintError(argc,argv);
+				}
+				long n;
+				if (!OCParseNumber(argv[i++],0,LONG_MAX,n)) {
+					PrintError(argc,argv);
+				}
+				GTableBudget = (size_t)n;
+			} else if (!strcmp(ptr,"-e")) {
+				GTableBlob = true;
+			} else if (!strcmp(ptr,"-n")) {
+				GCopyText = false;
+			} else if (!strcmp(ptr,"-d")) {
+				GTrackLines = false;
+			} else if (!strcmp(ptr,"-p")) {
+				if (i >= argc) {
+					PrintError(argc,argv);
+				}
+				GProfilePath = argv[i++];
 			} else if (!strcmp(ptr,"-l")) {
 				if (i >= argc) {
 					PrintError(argc,argv);
@@ -169,6 +288,71 @@ static void ParseArgs(int argc, const char *argv[])
 	}
 }
 
+/*	ProfileFile
+ *
+ *		Run the contents of a file through the DFA
+ */
+
+static bool ProfileFile(OCLexDFA &dfa, const char *path)
+{
+	FILE *f = fopen(path,"rb");
+	if (f == NULL) return false;
+
+	std::vector<unsigned char> data;
+	unsigned char buffer[65536];
+	size_t len;
+	while (0 < (len = fread(buffer,1,sizeof(buffer),f))) {
+		data.insert(data.end(),buffer,buffer + len);
+	}
+	fclose(f);
+
+	dfa.ProfileText(data.data(),data.size());
+	return true;
+}
+
+/*	ProfileDFA
+ *
+ *		If we were given sample input, run it through the DFA and reorder
+ *	the DFA by how often its states and classes were used. The path is a
+ *	file, or a directory whose files are all used.
+ */
+
+static void ProfileDFA(OCLexDFA &dfa)
+{
+	if (GProfilePath == NULL) return;
+
+	struct stat st;
+	if (stat(GProfilePath,&st) != 0) {
+		printf("Profile input %s not found\n",GProfilePath);
+		exit(1);
+	}
+
+	if (S_ISDIR(st.st_mode)) {
+		DIR *dir = opendir(GProfilePath);
+		if (dir == NULL) {
+			printf("Unable to read directory %s\n",GProfilePath);
+			exit(1);
+		}
+
+		struct dirent *entry;
+		char path[FILENAME_MAX];
+		while (NULL != (entry = readdir(dir))) {
+			if (entry->d_name[0] == '.') continue;
+
+			snprintf(path,sizeof(path),"%s/%s",GProfilePath,entry->d_name);
+			if ((stat(path,&st) == 0) && S_ISREG(st.st_mode)) {
+				ProfileFile(dfa,path);
+			}
+		}
+		closedir(dir);
+	} else if (!ProfileFile(dfa,GProfilePath)) {
+		printf("Unable to read profile input %s\n",GProfilePath);
+		exit(1);
+	}
+
+	dfa.ReorderDFA();
+}
+
 /*	main
  *
  *		Kick off the parser
@@ -275,6 +459,14 @@ int main(int argc, const char * argv[])
 		generator.valueUnion = parser.valueUnion;
 		generator.endCode = parser.endCode;
 		generator.ruleStates = parser.ruleStates;
+		generator.verbose = GVerbose;
+		generator.threads = GThreads;
+		generator.maxStates = GMaxStates;
+		generator.tableFormat = GTableFormat;
+		generator.tableBudget = GTableBudget;
+		generator.tableBlob = GTableBlob;
+		generator.copyText = GCopyText;
+		generator.trackLines = GTrackLines;
 
 		// Add rules and generate NFA
 		std::list<OCLexParser::Rule>::iterator i;
@@ -291,6 +483,9 @@ int main(int argc, const char * argv[])
 			return -1;
 		}
 
+		// Order the DFA by the sample input, if any
+		ProfileDFA(generator);
+
 		// Now write the final output files
 		strncpy(scratch,GOutputFile,sizeof(scratch)-1);
 		strncat(scratch,".h",sizeof(scratch) - strlen(scratch) - 1);
@@ -326,6 +521,8 @@ int main(int argc, const char * argv[])
 		generator.valueUnion = parser.valueUnion;
 		generator.endCode = parser.endCode;
 		generator.ruleStates = parser.ruleStates;
+		generator.verbose = GVerbose;
+		generator.threads = GThreads;
 
 		// Add rules and generate NFA
 		std::list<OCLexParser::Rule>::iterator i;
@@ -342,6 +539,9 @@ int main(int argc, const char * argv[])
 			return -1;
 		}
 
+		// Order the DFA by the sample input, if any
+		ProfileDFA(generator);
+
 		// Generate swift file
 		strncpy(scratch,GOutputFile,sizeof(scratch));
 		strncat(scratch,".swift",sizeof(scratch) - strlen(scratch) - 1);
@@ -363,6 +563,8 @@ int main(int argc, const char * argv[])
 		generator.valueUnion = parser.valueUnion;
 		generator.endCode = parser.endCode;
 		generator.ruleStates = parser.ruleStates;
+		generator.verbose = GVerbose;
+		generator.threads = GThreads;
 
 		// Add rules and generate NFA
 		std::list<OCLexParser::Rule>::iterator i;
@@ -379,6 +581,9 @@ int main(int argc, const char * argv[])
 			return -1;
 		}
 
+		// Order the DFA by the sample input, if any
+		ProfileDFA(generator);
+
 		// Now write the final output files
 		strncpy(scratch,GOutputFile,sizeof(scratch)-1);
 		strncat(scratch,".h",sizeof(scratch) - strlen(scratch) - 1);
@@ -7,6 +7,7 @@
 //
 
 #include "OCYaccCPPGenerator.h"
+#include <OCUtilities.h>
 
 /************************************************************************/
 /*																		*/
@@ -30,7 +31,10 @@ static const char *GHeader1 =
 	"#include <stdint.h>\n"                                                   \
 	"#include <map>\n"                                                        \
 	"#include <vector>\n"                                                     \
-	"#include <string>\n";
+	"#include <string>\n"                                                     \
+	"#if __cplusplus >= 201703L\n"                                            \
+	"#include <string_view>\n"                                                \
+	"#endif\n";
 
 // 0
 static const char *GHeader2 =
@@ -56,7 +60,7 @@ static const char *GHeader3 =
 	"#define ERROR_STARTERRORID\t\t0x0100\t// Your errors should start with this\n" \
 	"\n";
 
-// 4
+// 5, class, class, class, class, offset
 static const char *GHeader3a =
 	"/*\t%sInput\n"                                                        	  \
 	" *\n"                                                                    \
@@ -77,14 +81,59 @@ static const char *GHeader3a =
 	"\t\tstd::string text;\n"                                                 \
 	"\t\tstd::string abort;\n"                                                \
 	"\n"                                                                      \
-	"\t\tvirtual int32_t lex() = 0;\n";
+	"\t\tvirtual int32_t lex() = 0;\n"                                        \
+	"\n"                                                                      \
+	"%s"                                                                      \
+	"\t\t/*\n"                                                                \
+	"\t\t *\tThe text of the token just read, valid until the next call to\n" \
+	"\t\t *\tlex(). By default this is text; a lexer which reads its tokens\n" \
+	"\t\t *\tin place can return them without copying them into text.\n"      \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual const char *textData(void) const\n"                          \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn text.data();\n"                                           \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual size_t textLength(void) const\n"                             \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn text.size();\n"                                           \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"#if __cplusplus >= 201703L\n"                                            \
+	"\t\tstd::string_view textView(void) const\n"                             \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn std::string_view(textData(),textLength());\n"             \
+	"\t\t\t}\n"                                                               \
+	"#endif\n";
+
+// 0
+static const char *GHeaderOffset =
+	"\t\t/*\n"                                                                \
+	"\t\t *\tThe offset of the token just read in the file, and the line and\n" \
+	"\t\t *\tcolumn of an offset. A lexer which defers finding line and column\n" \
+	"\t\t *\tuntil asked returns the offset; by default there is none, and\n" \
+	"\t\t *\tline and column are used.\n"                                     \
+	"\t\t */\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual int64_t tokenOffset(void) const\n"                           \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\treturn -1;\n"                                                    \
+	"\t\t\t}\n"                                                               \
+	"\n"                                                                      \
+	"\t\tvirtual void position(int64_t, int32_t &atLine, int32_t &atColumn)\n" \
+	"\t\t\t{\n"                                                               \
+	"\t\t\t\tatLine = line;\n"                                                \
+	"\t\t\t\tatColumn = column;\n"                                            \
+	"\t\t\t}\n"                                                               \
+	"\n";
 
 static const char *GHeader3a1 =
 	"};\n"                                                                    \
 	"\n"                                                                      \
 	"#endif\n";
 
-// 1, class
+// 2, class, offset
 static const char *GHeader3b =
 	"\n"                                                                      \
 	"/*\n"                                                                    \
@@ -96,8 +145,13 @@ static const char *GHeader3b =
 	"\tuint16_t state;\n"                                                     \
 	"\tint32_t line;\n"                                                       \
 	"\tint32_t column;\n"                                                     \
+	"%s"                                                                      \
 	"\tstd::string filename;\n";
 
+// 0
+static const char *GHeader3bOffset =
+	"\tint64_t offset;\t\t\t\t// from tokenOffset(), or -1\n";
+
 // 5, class, class, class, lex, class
 static const char *GHeader3c =
 	"};\n"                                                                    \
@@ -117,7 +171,7 @@ static const char *GHeader3c =
 	"\n"                                                                      \
 	"\t\tbool parse(void);\n";
 
-// 3, class, lex, class
+// 6, class, lex, offset, class, class, class
 static const char *GHeader4 =
 	"\tprivate:\n"                                                            \
 	"\t\tstd::vector<%sStack> stack;\n"                                       \
@@ -128,6 +182,7 @@ static const char *GHeader4 =
 	"\t\tbool hasError;\n"                                                    \
 	"\t\tint32_t errorLine;\n"                                                \
 	"\t\tint32_t errorColumn;\n"                                              \
+	"%s"                                                                      \
 	"\t\tstd::string errorFileName;\n"										  \
 	"\n"                                                                      \
 	"\t\t%sStack processReduction(int16_t rule);\n"                           \
@@ -136,9 +191,15 @@ static const char *GHeader4 =
 	"\t\tvoid errorWithCode(int32_t code, std::map<std::string,std::string> &data);\n" \
 	"\t\tvoid errorWithCode(int32_t code);\n"                                 \
 	"\t\tvoid errorOK();\n"                                                   \
+	"\t\tint32_t lineOf(%sStack &s);\n"                                       \
+	"\t\tint32_t columnOf(%sStack &s);\n"                                     \
 	"\t\tstd::string tokenToString(uint32_t token);\n"                        \
 	"\t\tbool reduceByAction(int16_t action);\n";
 
+// 0
+static const char *GHeader4Offset =
+	"\t\tint64_t errorOffset;\n";
+
 static const char *GHeader5 =
 	"};\n"                                                                    \
 	"\n"                                                                      \
@@ -214,7 +275,7 @@ static const char *GSource5 = // 0
 	"}\n"                                                                     \
 	"\n";
 
-static const char *GSource6 = // 4
+static const char *GSource6 = // 5
 	"\n"                                                                      \
 	"/*\n"                                                                    \
 	" *\tProcess production rule. This processes the production rule and creates\n" \
@@ -234,6 +295,7 @@ static const char *GSource6 = // 4
 	"\ts.filename = fs.filename;\n"                                           \
 	"\ts.line = fs.line;\n"                                                   \
 	"\ts.column = fs.column;\n"                                               \
+	"%s"                                                                      \
 	"\n"                                                                      \
 	"\t// Now process production.\n"                                          \
 	"\t//\n"                                                                  \
@@ -244,7 +306,7 @@ static const char *GSource6 = // 4
 	"\ttry {\n"                                                               \
 	"\t\tswitch (rule) {\n";
 
-static const char *GSource7 = // 16
+static const char *GSource7 = // 25
 	"\t\t\tdefault:\n"                                                        \
 	"\t\t\t\tbreak;\n"                                                        \
 	"\t\t}\n"                                                                 \
@@ -337,10 +399,10 @@ static const char *GSource7 = // 16
 	"\t// Call delegate with current token position\n"                        \
 	"\t// Token position is the topmost symbol\n"                             \
 	"\tif (hasError) {\n"                                                     \
-	"\t\terror(errorLine,errorColumn,errorFileName,code,data);\n"             \
+	"%s"                                                                      \
 	"\t} else {\n"                                                            \
 	"\t\t%sStack &top = stack.back();\n"                                      \
-	"\t\terror(top.line,top.column,top.filename,code,data);\n"                \
+	"\t\terror(lineOf(top),columnOf(top),top.filename,code,data);\n"          \
 	"\t}\n"                                                                   \
 	"\n"                                                                      \
 	"\t// And now skip the next 3 token shifts so we don\'t spew garbage.\n"  \
@@ -361,6 +423,21 @@ static const char *GSource7 = // 16
 	"\terrorCount = 0;\n"                                                     \
 	"}\n"                                                                     \
 	"\n"                                                                      \
+	"/*\n"                                                                    \
+	" *\tThe line and column of a symbol on the stack. If the lexer gave us the\n" \
+	" *\toffset of the token, we ask it for them now.\n"                      \
+	" */\n"                                                                   \
+	"\n"                                                                      \
+	"int32_t %s::lineOf(%sStack &s)\n"                                        \
+	"{\n"                                                                     \
+	"%s"                                                                      \
+	"}\n"                                                                     \
+	"\n"                                                                      \
+	"int32_t %s::columnOf(%sStack &s)\n"                                      \
+	"{\n"                                                                     \
+	"%s"                                                                      \
+	"}\n"                                                                     \
+	"\n"                                                                      \
 	"std::string %s::tokenToString(uint32_t token)\n"                         \
 	"{\n"                                                                     \
 	"\tif (token >= K_FIRSTTOKEN) {\n"                                        \
@@ -447,6 +524,7 @@ static const char *GSource7 = // 16
 	"\tinitStack.filename = lex->filename;\n"                                 \
 	"\tinitStack.line = lex->line;\n"                                         \
 	"\tinitStack.column = lex->column;\n"                                     \
+	"%s"                                                                      \
 	"\tstack.push_back(initStack);\n"                                         \
 	"\n"                                                                      \
 	"\t/*\n"                                                                  \
@@ -487,6 +565,7 @@ static const char *GSource7 = // 16
 	"\t\t\terrorFileName = lex->filename;\n"                                  \
 	"\t\t\terrorLine = lex->line;\n"                                          \
 	"\t\t\terrorColumn = lex->column;\n"                                      \
+	"%s"                                                                      \
 	"\t\t\thasError = true;\n"                                                \
 	"\n"                                                                      \
 	"\t\t\t/*\n"                                                              \
@@ -518,6 +597,47 @@ static const char *GSource7 = // 16
 	"\t\t\t\t\t%sStack stmp;\n"                                               \
 	"\t\t\t\t\tstmp.state = action;\n";
 
+/*
+ *	With -d the lexer finds line and column only when asked, so each stack
+ *	entry holds the offset of its token, and line and column are found
+ *	from it as needed. Otherwise line and column are used as they are.
+ */
+
+// 0
+static const char *GErrorLine =
+	"\t\terror(errorLine,errorColumn,errorFileName,code,data);\n";
+
+// 0
+static const char *GErrorOffset =
+	"\t\tint32_t line = errorLine;\n"                                         \
+	"\t\tint32_t column = errorColumn;\n"                                     \
+	"\t\tif (errorOffset >= 0) lex->position(errorOffset,line,column);\n"     \
+	"\t\terror(line,column,errorFileName,code,data);\n";
+
+// 0
+static const char *GLineOf =
+	"\treturn s.line;\n";
+
+// 0
+static const char *GLineOfOffset =
+	"\tif (s.offset < 0) return s.line;\n"                                    \
+	"\n"                                                                      \
+	"\tint32_t line,column;\n"                                                \
+	"\tlex->position(s.offset,line,column);\n"                                \
+	"\treturn line;\n";
+
+// 0
+static const char *GColumnOf =
+	"\treturn s.column;\n";
+
+// 0
+static const char *GColumnOfOffset =
+	"\tif (s.offset < 0) return s.column;\n"                                  \
+	"\n"                                                                      \
+	"\tint32_t line,column;\n"                                                \
+	"\tlex->position(s.offset,line,column);\n"                                \
+	"\treturn column;\n";
+
 static const char *GSource8 = // 10
 	"\t\t\t\t\tstmp.filename = lex->filename;\n"                              \
 	"\t\t\t\t\tstmp.line = lex->line;\n"                                      \
@@ -738,6 +858,8 @@ static const char *GSource10 = // 0
 
 OCYaccCPPGenerator::OCYaccCPPGenerator(const OCYaccParser &p, const OCYaccLR1 &y) : parser(p), state(y)
 {
+	tableBlob = false;
+	lexOffsets = false;
 }
 
 /*	OCYaccCPPGenerator::~OCYaccCPPGenerator
@@ -844,21 +966,23 @@ void OCYaccCPPGenerator::WriteRule(FILE *f, const OCYaccLR1::Reduction &rule)
 						param.push_back(*ptr++);
 					}
 
+					std::string entry;
 					if (value == 1) {
-						ret += "(stack[pos].";
+						entry = "stack[pos]";
 					} else {
-						sprintf(buffer,"(stack[pos + %zu].",value-1);
-						ret += buffer;
+						sprintf(buffer,"stack[pos + %zu]",value-1);
+						entry = buffer;
 					}
 
+					// Line and column may be found from the token offset
 					if (param == "file") {
-						ret += "filename)";
+						ret += "(" + entry + ".filename)";
 					} else if (param == "line") {
-						ret += "line)";
+						ret += "lineOf(" + entry + ")";
 					} else if (param == "col") {
-						ret += "column)";
+						ret += "columnOf(" + entry + ")";
 					} else {
-						ret += "state)";
+						ret += "(" + entry + ".state)";
 						fprintf(stderr,"Warning: Unknown synthetic type $%zu_%s\n",value,param.c_str());
 					}
 
@@ -940,6 +1064,11 @@ void OCYaccCPPGenerator::WriteYTables(FILE *f)
 	}
 	fprintf(f,"\n};\n\n");
 
+	if (tableBlob) {
+		WriteBlobTables(f);
+		return;
+	}
+
 	// Reduction table
 	len = state.reductions.size();
 	fprintf(f,"/*  RuleLength\n *\n *      The number of tokens a reduce action removes from the stack\n */\n\n");
@@ -1080,6 +1209,76 @@ void OCYaccCPPGenerator::WriteYTables(FILE *f)
 	fprintf(f,"\n};\n\n");
 }
 
+/*	OCYaccCPPGenerator::WriteBlobTables
+ *
+ *		Write the reduction, action and goto tables as strings, which the
+ *	compiler reads far faster than lists of numbers. The tables have the
+ *	same names and types as those written by WriteYTables.
+ */
+
+void OCYaccCPPGenerator::WriteBlobTables(FILE *f)
+{
+	OCTableBlob blob;
+	std::vector<uint32_t> list;
+	size_t i,len;
+
+	// Reduction table
+	len = state.reductions.size();
+	fprintf(f,"/*  RuleLength\n *\n *      The number of tokens a reduce action removes from the stack\n */\n\n");
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = (uint32_t)state.reductions[i].reduce;
+	blob.WriteTable(f,"RuleLength",list.data(),len,sizeof(uint8_t));
+
+	fprintf(f,"/*  RuleProduction\n *\n *      The prodution ID we reduce to\n */\n\n");
+	for (i = 0; i < len; ++i) list[i] = state.reductions[i].production;
+	blob.WriteTable(f,"RuleProduction",list.data(),len,sizeof(uint32_t));
+
+	// Action tables
+	fprintf(f,"/*\n *  The following tables are compressed using CSR format.\n");
+	fprintf(f," *  See https://en.wikipedia.org/wiki/Sparse_matrix\n");
+	fprintf(f," */\n\n");
+
+	fprintf(f,"/*  ActionI, J, A\n *\n *      Compressed action index table.\n */\n\n");
+	len = state.actionI.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = (uint32_t)state.actionI[i];
+	blob.WriteTable(f,"ActionI",list.data(),len,sizeof(uint32_t));
+
+	len = state.actionJ.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = state.actionJ[i];
+	blob.WriteTable(f,"ActionJ",list.data(),len,sizeof(uint32_t));
+
+	len = state.actionA.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) {
+		int32_t val = (int32_t)(state.actionA[i].value);
+		if (state.actionA[i].reduce) {
+			val = -val-1;
+		}
+		list[i] = (uint32_t)val;
+	}
+	fprintf(f,"// Note: < 0 -> reduce (rule = -a-1), >= 0 -> shift (state).\n");
+	blob.WriteTable(f,"ActionA",list.data(),len,sizeof(int16_t),true);
+
+	// Goto table
+	fprintf(f,"/*  GotoI, J, A\n *\n *      Compressed goto table.\n */\n\n");
+	len = state.actionI.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = (uint32_t)state.gotoI[i];
+	blob.WriteTable(f,"GotoI",list.data(),len,sizeof(uint32_t));
+
+	len = state.gotoJ.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = state.gotoJ[i];
+	blob.WriteTable(f,"GotoJ",list.data(),len,sizeof(uint32_t));
+
+	len = state.gotoA.size();
+	list.resize(len);
+	for (i = 0; i < len; ++i) list[i] = (uint32_t)state.gotoA[i];
+	blob.WriteTable(f,"GotoA",list.data(),len,sizeof(int16_t),true);
+}
+
 /************************************************************************/
 /*																		*/
 /*	Write Files															*/
@@ -1104,6 +1303,11 @@ void OCYaccCPPGenerator::WriteOCFile(const char *classname, const char *outputNa
 	// Prefix
 	fprintf(f,GSource1,outputName,outputName);
 
+	// The tables written as strings are read with memcpy
+	if (tableBlob) {
+		fprintf(f,"#include <string.h>\n");
+	}
+
 	// If we define a lex header, insert it
 	if (parser.lexerHeader.size() > 0) {
 		fprintf(f,"#include \"%s\"\n",parser.lexerHeader.c_str());
@@ -1133,7 +1337,8 @@ void OCYaccCPPGenerator::WriteOCFile(const char *classname, const char *outputNa
 	fprintf(f, "%s\n", parser.endCode.c_str());
 
 	// Production (to switch statement)
-	fprintf(f, GSource6, classname, classname, classname, classname);
+	fprintf(f, GSource6, classname, classname, classname, classname,
+						 lexOffsets ? "\ts.offset = fs.offset;\n" : "");
 
 	// Print information about the rules we're reducing by
 	fprintf(f,"\n        // Production rules\n");
@@ -1152,25 +1357,40 @@ void OCYaccCPPGenerator::WriteOCFile(const char *classname, const char *outputNa
 
 	// Close switch, finish writing the rest
 	fprintf(f, GSource7, classname, classname, classname, classname,
-						 classname, classname, classname, classname,
-						 classname, classname, classname, classname,
-						 classname, classname, classname, classname);
+						 classname, lexOffsets ? GErrorOffset : GErrorLine,
+						 classname, classname, classname,
+						 classname, classname, lexOffsets ? GLineOfOffset : GLineOf,
+						 classname, classname, lexOffsets ? GColumnOfOffset : GColumnOf,
+						 classname, classname, classname, classname, classname,
+						 lexOffsets ? "\tinitStack.offset = lex->tokenOffset();\n" : "",
+						 classname,
+						 lexOffsets ? "\t\t\terrorOffset = lex->tokenOffset();\n" : "",
+						 classname, classname);
 
 	if (parser.valueUnion.size() > 0) {
 		fprintf(f,"\t\t\t\t\tstmp.value = lex->value;\n");
 	}
+	if (lexOffsets) {
+		fprintf(f,"\t\t\t\t\tstmp.offset = lex->tokenOffset();\n");
+	}
 
 	fprintf(f, GSource8, classname, classname);
 
 	if (parser.valueUnion.size() > 0) {
 		fprintf(f,"\t\t\t\tstmp.value = lex->value;\n");
 	}
+	if (lexOffsets) {
+		fprintf(f,"\t\t\t\tstmp.offset = top.offset;\n");
+	}
 
 	fprintf(f, GSource9, classname);
 
 	if (parser.valueUnion.size() > 0) {
 		fprintf(f,"\t\t\tstmp.value = lex->value;\n");
 	}
+	if (lexOffsets) {
+		fprintf(f,"\t\t\tstmp.offset = lex->tokenOffset();\n");
+	}
 
 	fprintf(f, "%s", GSource10);
 }
@@ -1246,13 +1466,14 @@ void OCYaccCPPGenerator::WriteOCHeader(const char *classname, const char *output
 		 *		(classname)Value -- the union value of the values
 		 */
 
-		fprintf(f,GHeader3a,classname,classname,classname,classname);
+		fprintf(f,GHeader3a,classname,classname,classname,classname,
+				lexOffsets ? GHeaderOffset : "");
 		if (parser.valueUnion.size() > 0) {
 			fprintf(f,"\t\tunion %sValue value;\n",classname);
 		}
 		fprintf(f,"%s",GHeader3a1);
 	}
-	fprintf(f,GHeader3b,classname);
+	fprintf(f,GHeader3b,classname,lexOffsets ? GHeader3bOffset : "");
 	if (parser.valueUnion.size() > 0) {
 		fprintf(f,"\tunion %sValue value;\n",lexerClass);
 	}
@@ -1268,7 +1489,8 @@ void OCYaccCPPGenerator::WriteOCHeader(const char *classname, const char *output
 		fprintf(f,"\n%s\n",parser.classGlobal.c_str());
 
 		// Private
-		fprintf(f,GHeader4,classname,lexerClass,classname);
+		fprintf(f,GHeader4,classname,lexerClass,lexOffsets ? GHeader4Offset : "",
+				classname,classname,classname);
 	} else {
 		std::string abstractName = lexerClass;
 		abstractName.append("Input");
@@ -1278,7 +1500,8 @@ void OCYaccCPPGenerator::WriteOCHeader(const char *classname, const char *output
 		fprintf(f,"\n%s\n",parser.classGlobal.c_str());
 
 		// Private
-		fprintf(f,GHeader4,classname,abstractName.c_str(),classname);
+		fprintf(f,GHeader4,classname,abstractName.c_str(),lexOffsets ? GHeader4Offset : "",
+				classname,classname,classname);
 	}
 
 	// Insert class declarations
@@ -32,11 +32,15 @@ class OCYaccCPPGenerator
 		void WriteOCHeader(const char *classname, const char *outputName, FILE *f);
 		void WriteOCFile(const char *classname, const char *outputName, FILE *f);
 
+		bool tableBlob;					// write the tables as a string blob
+		bool lexOffsets;				// lexer gives token offsets (-d)
+
 	private:
 		const OCYaccParser &parser;
 		const OCYaccLR1 &state;
 
 		void WriteYTables(FILE *f);
+		void WriteBlobTables(FILE *f);
 		void WriteRule(FILE *f,  const OCYaccLR1::Reduction &rule);
 };
 
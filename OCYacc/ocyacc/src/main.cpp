@@ -22,11 +22,18 @@ static const char *GHelp =
 	"pattern matching on text. This tool takes an input grammar which is \n"  \
 	"similar to yacc or bison, but generates a re-entrant Objective-C class.\n" \
 	"\n"                                                                      \
-	"Usage: ocyacc [-h] [-l [oc|c++]] [-o filename] [-c classname] inputfile\n" \
+	"Usage: ocyacc [-h] [-e] [-d] [-l [oc|c++]] [-o filename] [-c classname] inputfile\n" \
 	"\n"                                                                      \
 	"-h  Prints this help file. This help file will also be printed if any illegal\n" \
 	"    parameters are provided. \n"                                         \
 	"\n"                                                                      \
+	"-e  Write the parser tables as one string of bytes rather than lists of\n" \
+	"    numbers (C++ only). Large grammars compile much faster.\n"           \
+	"\n"                                                                      \
+	"-d  The lexer finds line and column only when asked, as oclex -d does\n" \
+	"    (C++ only). The parser keeps each token's tokenOffset(), and calls\n" \
+	"    position() on the lexer when it needs a line or column.\n"           \
+	"\n"                                                                      \
 	"-l  Select language. Arguments are oc for Objective-C and c++ for C++. If\n" \
 	"    not provided, uses Objective-C as default.\n"                        \
 	"\n"                                                                      \
@@ -70,6 +77,8 @@ static char GOutputFileName[FILENAME_MAX];
 static char GInputFile[FILENAME_MAX];
 static char GClassName[FILENAME_MAX];
 static LanguageEnum GLanguage = KLanguageOP;
+static bool GTableBlob = false;
+static bool GLexOffsets = false;
 
 /*	PrintHelp
  *
@@ -106,6 +115,8 @@ static void PrintError(int argc, const char *argv[])
  *		The parameters we accept are:
  *
  *		-h			Help
+ *		-e			Write the tables as a blob (C++)
+ *		-d			Lexer gives token offsets (C++)
  *		-c class	Output class name (default is input file name)
  *		-o file		Output file name (default is input file name)
  *		input		Input file name
@@ -124,6 +135,10 @@ static void ParseArgs(int argc, const char *argv[])
 		if (*ptr == '-') {
 			if (!strcmp(ptr,"-h")) {
 				PrintHelp();
+			} else if (!strcmp(ptr,"-e")) {
+				GTableBlob = true;
+			} else if (!strcmp(ptr,"-d")) {
+				GLexOffsets = true;
 			} else if (!strcmp(ptr,"-l")) {
 				if (i >= argc) {
 					PrintError(argc,argv);
@@ -295,6 +310,8 @@ int main(int argc, const char * argv[])
 		fclose(out);
 	} else if (GLanguage == KLanguageCPP) {
 		OCYaccCPPGenerator generator(parser,stateMachine);
+		generator.tableBlob = GTableBlob;
+		generator.lexOffsets = GLexOffsets;
 
 		// Now write the final output files
 		strncpy(scratch,GOutputFile,sizeof(scratch)-1);